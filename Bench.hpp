@@ -0,0 +1,83 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bench {
+	// one measure() call, for report()
+	struct Result {
+		std::string group, name;
+		std::uint64_t iterations;
+		double seconds;
+		double itemsPerSecond;
+
+		double nsPerIteration() const { return seconds*1e9 / iterations; }
+	};
+
+	// what measure() has reported so far; group is set by the caller to file them under
+	inline std::vector<Result> results;
+	inline std::string group;
+
+	// keeps the compiler from discarding a computed value
+	template <typename T> inline void doNotOptimize(const T &value) {
+		asm volatile("" : : "r,m"(value) : "memory");
+	}
+
+	// Runs body() in growing batches until a batch takes at least minSeconds, then reports
+	// the time per call and per item, `items` being what one call of body() processes.
+	template <typename F> double measure(std::string_view name, std::uint64_t items, F &&body, double minSeconds = 0.3) {
+		using Clock = std::chrono::steady_clock;
+		for (std::uint64_t iterations=1; ; iterations*=2) {
+			const auto begin = Clock::now();
+			for (std::uint64_t i=0; i<iterations; ++i) body();
+			const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+			if (seconds < minSeconds) continue;
+
+			const double itemsPerSecond = iterations * items / seconds;
+			results.push_back({group, std::string(name), iterations, seconds, itemsPerSecond});
+			std::cout <<name <<": " <<seconds*1e9/iterations <<" ns/iteration, "
+				<<static_cast<std::uint64_t>(itemsPerSecond) <<" items/s" <<std::endl;
+			return itemsPerSecond;
+		}
+	}
+
+	enum class Format { json, csv };
+
+	// every result so far, machine-readable: JSON laid out as Google Benchmark's, or CSV
+	inline void report(std::ostream &out, Format format) {
+		// a JSON string, or a CSV field with quotes doubled
+		const auto quoted = [format](std::string_view s) {
+			std::string result{'"'};
+			for (char c: s) {
+				if (c=='"') result += format==Format::csv ?'"' :'\\';
+				else if (c=='\\' && format==Format::json) result += '\\';
+				result += c;
+			}
+			return result + '"';
+		};
+
+		if (format == Format::csv) {
+			out <<"name,iterations,real_time,time_unit,items_per_second\n";
+			for (const Result &r: results) {
+				out <<quoted(r.group + "/" + r.name) <<',' <<r.iterations <<',' <<r.nsPerIteration() <<",ns," <<r.itemsPerSecond <<'\n';
+			}
+			out.flush();
+			return;
+		}
+
+		out <<"{\n  \"benchmarks\": [";
+		for (std::size_t i=0; i<results.size(); ++i) {
+			const Result &r = results[i];
+			out <<(i ?",\n" :"\n") <<"    {\"name\": " <<quoted(r.group + "/" + r.name) <<", \"iterations\": " <<r.iterations
+				<<", \"real_time\": " <<r.nsPerIteration() <<", \"time_unit\": \"ns\", \"items_per_second\": " <<r.itemsPerSecond <<'}';
+		}
+		out <<"\n  ]\n}" <<std::endl;
+	}
+}
+
+#endif
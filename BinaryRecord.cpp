@@ -0,0 +1,87 @@
+#include "BinaryRecord.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::string_view;
+using std::uint16_t;
+using std::uint8_t;
+
+namespace BinaryRecord {
+	namespace {
+		const uint8_t *bytesOf(const string_view data, const size_t offset) {
+			return reinterpret_cast<const uint8_t *>(data.data()) + offset;
+		}
+	}
+
+	void savePositions(const Board *boards, const size_t n, uint8_t *out) {
+		for (size_t i=0; i<n; ++i) boards[i].pack(out + i*POSITION_SIZE);
+	}
+
+	size_t loadPositions(const string_view data, Board *out, const size_t n) {
+		const size_t available = data.size() / POSITION_SIZE;
+		for (size_t i=0; i<n && i<available; ++i) {
+			const optional<Board> board = Board::unpack(bytesOf(data, i*POSITION_SIZE));
+			if (!board.has_value()) return i;
+			out[i] = *board;
+		}
+		return n<available ?n :available;
+	}
+
+	uint8_t *saveGame(const Board &start, const Move *moves, const size_t n, const GameRecord::Result result, uint8_t *out,
+			const std::int16_t *scores) {
+		assert(n <= MAX_PLIES);
+		start.pack(out);
+		out += POSITION_SIZE;
+		*out++ = static_cast<uint8_t>(result);
+		*out++ = scores ?SCORED :0;
+		*out++ = n & 0xff;
+		*out++ = n >> 8;
+		for (size_t i=0; i<n; ++i) {
+			*out++ = moves[i].from;
+			*out++ = moves[i].to;
+		}
+		for (size_t i=0; scores && i<n; ++i) {
+			*out++ = static_cast<uint16_t>(scores[i]) & 0xff;
+			*out++ = static_cast<uint16_t>(scores[i]) >> 8;
+		}
+		return out;
+	}
+
+	optional<Game> GameReader::next() {
+		if (failed_ || pos >= data.size()) return nullopt;
+
+		const auto fail = [this]() -> optional<Game> {
+			failed_ = true;
+			return nullopt;
+		};
+
+		if (data.size() - pos < GAME_HEADER_SIZE) return fail();
+		const uint8_t *header = bytesOf(data, pos);
+		const optional<Board> start = Board::unpack(header);
+		if (!start.has_value()) return fail();
+
+		const uint8_t result = header[POSITION_SIZE];
+		const uint8_t flags = header[POSITION_SIZE+1];
+		if (result > static_cast<uint8_t>(GameRecord::Result::draw) || (flags & ~SCORED) != 0) return fail();
+
+		const bool scored = flags & SCORED;
+		const size_t plies = header[POSITION_SIZE+2] | header[POSITION_SIZE+3] << 8;
+		if (data.size() - pos < gameSize(plies, scored)) return fail();
+
+		const uint8_t *moves = header + GAME_HEADER_SIZE;
+		for (size_t i=0; i<2*plies; ++i) {
+			if (moves[i] >= Board::N_SQUARE) return fail();
+		}
+
+		const Game game{*start, static_cast<GameRecord::Result>(result), moves, plies, pos, scored ?moves + 2*plies :nullptr};
+		pos += gameSize(plies, scored);
+		return game;
+	}
+}
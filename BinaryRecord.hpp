@@ -0,0 +1,72 @@
+#ifndef BINARY_RECORD_HPP
+#define BINARY_RECORD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "Board.hpp"
+#include "GameRecord.hpp"
+#include "Move.hpp"
+
+// Compact binary files of positions and games, read in place from a MappedFile.
+//
+// A position file is an array of Board::pack() records, 32 bytes each.
+// A game file is a sequence of games, each
+//
+//   32 bytes   the start position, Board::pack()
+//   1 byte     GameRecord::Result
+//   1 byte     flags: SCORED, or 0
+//   2 bytes    number of moves n, little-endian
+//   2n bytes   the moves, from and to square index
+//   2n bytes   with SCORED only: the search score of each move for its mover, int16 little-endian
+namespace BinaryRecord {
+	constexpr std::size_t POSITION_SIZE = Board::PACKED_SIZE;
+	constexpr std::size_t GAME_HEADER_SIZE = POSITION_SIZE + 4;
+	constexpr std::size_t MAX_PLIES = 0xffff;
+	constexpr std::uint8_t SCORED = 1;
+
+	// writes n positions to out, which must hold n*POSITION_SIZE bytes
+	void savePositions(const Board *boards, std::size_t n, std::uint8_t *out);
+	// Reads the first n positions of `data` into out, stopping at the first invalid one
+	// or the end of the data; returns how many were read.
+	std::size_t loadPositions(std::string_view data, Board *out, std::size_t n);
+
+	constexpr std::size_t gameSize(std::size_t plies, bool scored = false) { return GAME_HEADER_SIZE + (scored ?4 :2)*plies; }
+	// Writes a game of n <= MAX_PLIES moves to out, which must hold gameSize(n, scores) bytes,
+	// with the n scores if not null; returns the end of what was written.
+	std::uint8_t *saveGame(const Board &start, const Move *moves, std::size_t n, GameRecord::Result result, std::uint8_t *out,
+		const std::int16_t *scores = nullptr);
+
+	struct Game {
+		Board start;
+		GameRecord::Result result;
+		const std::uint8_t *moves;  // pointing into the file
+		std::size_t plies;
+		std::size_t offset;         // of the game within the file
+		const std::uint8_t *scores; // pointing into the file, null if the game has none
+
+		Move move(std::size_t i) const { return Move{moves[2*i], moves[2*i+1]}; }
+		int score(std::size_t i) const { return static_cast<std::int16_t>(scores[2*i] | scores[2*i+1] << 8); }
+	};
+
+	// The games of a game file in order. Moves are checked to be on the board, not to be
+	// legal; replay them with Board::isMoveable() where that matters.
+	class GameReader {
+		private:
+			std::string_view data;
+			std::size_t pos = 0;
+			bool failed_ = false;
+
+		public:
+			explicit GameReader(std::string_view data_): data(data_) { }
+
+			// nullopt at the end of the data or at a malformed game
+			std::optional<Game> next();
+			bool failed() const { return failed_; }
+			std::size_t position() const { return pos; }
+	};
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "Bitboard.hpp"
+#include "Square.hpp"
+#include "Vector2d.hpp"
+
+#include <array>
+#include <cstdint>
+
+using std::array;
+using std::uint8_t;
+using std::uint16_t;
+
+namespace BitboardNS {
+	namespace {
+		LineAttacks makeLineAttacks(const int length, const int pos, const uint16_t occupancy) {
+			LineAttacks result{0, 0, 0};
+			for (int dir: {-1, 1}) {
+				int i = pos + dir;
+				for (; 0<=i && i<length && !(occupancy>>i & 1); i+=dir) result.slide |= 1<<i;
+				if (!(0<=i && i<length)) continue;
+				result.firstBlocker |= 1<<i;
+				for (i+=dir; 0<=i && i<length && !(occupancy>>i & 1); i+=dir) { }
+				if (0<=i && i<length) result.secondBlocker |= 1<<i;
+			}
+			return result;
+		}
+
+		template <int LENGTH> struct LineTable {
+			array<array<LineAttacks, 1<<LENGTH>, LENGTH> attacks;
+
+			LineTable() {
+				for (int pos=0; pos<LENGTH; ++pos) {
+					for (int occ=0; occ<(1<<LENGTH); ++occ) {
+						attacks[pos][occ] = makeLineAttacks(LENGTH, pos, occ);
+					}
+				}
+			}
+		};
+
+		const LineTable<N_COL> rankTable;
+		const LineTable<N_ROW> fileTable;
+
+		const array<Bitboard, 1<<N_ROW> fileSpread{[]{
+			array<Bitboard, 1<<N_ROW> result{};
+			for (int mask=0; mask<(1<<N_ROW); ++mask) {
+				for (int row=0; row<N_ROW; ++row) {
+					if (mask>>row & 1) result[mask] |= bit(row*N_COL);
+				}
+			}
+			return result;
+		}()};
+
+		constexpr Bitboard stepsWithin(const int from, const Bitboard area, std::initializer_list<Vector2d> deltas) {
+			Bitboard result = 0;
+			for (Vector2d d: deltas) {
+				const int to = SquareNS::step(from, d);
+				if (to!=NO_SQUARE && test(area, to)) result |= bit(to);
+			}
+			return result;
+		}
+
+		constexpr Tables makeTables() {
+			using SquareNS::diagonal;
+			using SquareNS::neighbours;
+			using SquareNS::orthogonal;
+			using SquareNS::step;
+			Tables t{};
+			const Bitboard all = (Bitboard{1} << N_SQUARE) - 1;
+
+			for (int i=0; i<N_SQUARE; ++i) {
+				const Vector2d p = SquareNS::vectorOf(i);
+				for (Team team: {Team::red, Team::black}) {
+					const int k = static_cast<int>(team);
+					if (SquareNS::inBase(team, p)) t.palace[k] |= bit(i);
+					if (SquareNS::inTeam(team, p)) t.half[k] |= bit(i);
+				}
+			}
+
+			for (int i=0; i<N_SQUARE; ++i) {
+				const Vector2d p = SquareNS::vectorOf(i);
+				for (Team team: {Team::red, Team::black}) {
+					const int k = static_cast<int>(team);
+					t.jiangSteps[k][i] = stepsWithin(i, t.palace[k], {orthogonal[0], orthogonal[1], orthogonal[2], orthogonal[3]});
+					t.shiSteps[k][i] = stepsWithin(i, t.palace[k], {diagonal[0], diagonal[1], diagonal[2], diagonal[3]});
+
+					// forward is +x for black, -x for red; sideways only once across the river
+					const Vector2d forward{team==Team::black ?1 :-1, 0};
+					t.zuSteps[k][i] = SquareNS::inTeam(team, p)
+						?stepsWithin(i, all, {forward})
+						:stepsWithin(i, all, {forward, {0,1}, {0,-1}});
+				}
+
+				for (int j=0; j<4; ++j) {
+					const int leg = neighbours[i][j];
+					const Vector2d side{orthogonal[j].y, orthogonal[j].x};
+					t.maLeg[i][j] = NO_SQUARE;
+					t.maByLeg[i][j] = 0;
+					if (leg == NO_SQUARE) continue;
+
+					const Bitboard targets = stepsWithin(leg, all, {orthogonal[j]+side, orthogonal[j]-side});
+					if (targets == 0) continue;
+					t.maLeg[i][j] = leg;
+					t.maByLeg[i][j] = targets;
+				}
+
+				for (int j=0; j<4; ++j) {
+					const int eye = step(i, diagonal[j]);
+					const int to = step(i, diagonal[j] + diagonal[j]);
+					t.xiangEye[i][j] = t.xiangByEye[i][j] = NO_SQUARE;
+					if (to == NO_SQUARE) continue;
+					t.xiangEye[i][j] = eye;
+					t.xiangByEye[i][j] = to;
+				}
+
+				for (int j=0; j<4; ++j) {
+					const int leg = step(i, diagonal[j]);
+					t.maAttackLeg[i][j] = NO_SQUARE;
+					t.maAttackersByLeg[i][j] = 0;
+					if (leg == NO_SQUARE) continue;
+
+					const Bitboard sources = stepsWithin(leg, all, {{diagonal[j].x, 0}, {0, diagonal[j].y}});
+					if (sources == 0) continue;
+					t.maAttackLeg[i][j] = leg;
+					t.maAttackersByLeg[i][j] = sources;
+				}
+			}
+
+			for (int i=0; i<N_SQUARE; ++i) {
+				for (int k=0; k<2; ++k) {
+					for (int j=0; j<N_SQUARE; ++j) {
+						if (test(t.zuSteps[k][i], j)) t.zuAttackers[k][j] |= bit(i);
+					}
+				}
+			}
+
+			return t;
+		}
+	}
+
+	// built at compile time, so usable from the initializers of other translation units
+	constexpr Tables tables = makeTables();
+
+	const LineAttacks &rankAttacks(const int col, const uint16_t rankOccupancy) {
+		return rankTable.attacks[col][rankOccupancy];
+	}
+
+	const LineAttacks &fileAttacks(const int row, const uint16_t fileOccupancy) {
+		return fileTable.attacks[row][fileOccupancy];
+	}
+
+	Bitboard fileToBitboard(const int col, const uint16_t mask) {
+		return fileSpread[mask] << col;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "Square.hpp"
+#include "Team.hpp"
+
+// bit x*9+y stands for the square (x,y), the same index as Board::indexOf()
+__extension__ typedef unsigned __int128 Bitboard;
+
+namespace BitboardNS {
+	using SquareNS::N_COL;
+	using SquareNS::N_ROW;
+	using SquareNS::N_SQUARE;
+	using SquareNS::NO_SQUARE;
+
+	constexpr Bitboard bit(int square) { return Bitboard{1} << square; }
+	constexpr bool test(Bitboard b, int square) { return (b >> square) & 1; }
+
+	inline int popCount(Bitboard b) {
+		return __builtin_popcountll(static_cast<std::uint64_t>(b)) + __builtin_popcountll(static_cast<std::uint64_t>(b >> 64));
+	}
+
+	inline int lowestSquare(Bitboard b) {
+		const std::uint64_t lo = static_cast<std::uint64_t>(b);
+		return lo ?__builtin_ctzll(lo) :64 + __builtin_ctzll(static_cast<std::uint64_t>(b >> 64));
+	}
+
+	inline int popLowest(Bitboard &b) {
+		const int square = lowestSquare(b);
+		b &= b - 1;
+		return square;
+	}
+
+	// Sliding along one rank (bit = column) or one file (bit = row), given the occupancy of
+	// that line.  slide holds the empty squares up to the nearest piece in each direction,
+	// firstBlocker those nearest pieces, secondBlocker the piece right behind each of them.
+	// Ju reaches slide|firstBlocker, Pao reaches slide|secondBlocker.
+	struct LineAttacks {
+		std::uint16_t slide, firstBlocker, secondBlocker;
+	};
+
+	const LineAttacks &rankAttacks(int col, std::uint16_t rankOccupancy);
+	const LineAttacks &fileAttacks(int row, std::uint16_t fileOccupancy);
+
+	inline Bitboard rankToBitboard(int row, std::uint16_t mask) { return Bitboard{mask} << (row*N_COL); }
+	Bitboard fileToBitboard(int col, std::uint16_t mask);
+
+	struct Tables {
+		std::array<Bitboard, 2> palace;
+		std::array<Bitboard, 2> half;
+		std::array<std::array<Bitboard, N_SQUARE>, 2> jiangSteps;
+		std::array<std::array<Bitboard, N_SQUARE>, 2> shiSteps;
+		std::array<std::array<Bitboard, N_SQUARE>, 2> zuSteps;
+
+		// the leg of a Ma and the two destinations it blocks; NO_SQUARE when off board
+		std::array<std::array<std::uint8_t, 4>, N_SQUARE> maLeg;
+		std::array<std::array<Bitboard, 4>, N_SQUARE> maByLeg;
+
+		// the eye of a Xiang and the destination it blocks, not yet restricted to one side of the river
+		std::array<std::array<std::uint8_t, 4>, N_SQUARE> xiangEye;
+		std::array<std::array<std::uint8_t, 4>, N_SQUARE> xiangByEye;
+
+		// the same the other way round, for looking outward from an attacked square: its
+		// diagonal neighbours, each the leg of a Ma on one of two squares that jumps onto it
+		std::array<std::array<std::uint8_t, 4>, N_SQUARE> maAttackLeg;
+		std::array<std::array<Bitboard, 4>, N_SQUARE> maAttackersByLeg;
+		// the squares from which a Zu steps onto a square
+		std::array<std::array<Bitboard, N_SQUARE>, 2> zuAttackers;
+	};
+
+	extern const Tables tables;
+}
+
+#endif
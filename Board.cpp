@@ -1,66 +1,105 @@
 #include "Board.hpp"
+#include "BoardRenderer.hpp"
+#include "Evaluator.hpp"
+#include "Instrument.hpp"
+#include "MoveKernel.hpp"
 #include "Piece.hpp"
 #include "Vector2d.hpp"
+#include "Zobrist.hpp"
 
+#include <algorithm>
 #include <optional>
 #include <array>
-#include <memory>
 #include <iostream>
 #include <string>
-#include <locale>
-#include <codecvt>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 using std::optional;
 using std::nullopt;
-using std::unique_ptr;
-using std::make_unique;
 using std::cout;
-using std::endl;
 using std::array;
 using std::vector;
-using std::u32string;
 using std::string;
 using std::string_view;
 using namespace std::literals;
 
-bool Board::inBound(const Vector2d p) {
-	return 0<=p.x && p.x<N_ROW && 0<=p.y && p.y<N_COL;
+static_assert(std::is_trivially_copyable_v<Board>, "snapshotting a position must be a memcpy");
+static_assert(sizeof(Board) <= 304, "a copy of the board is kept to the size stated with its members");
+
+Board::Board() {
+	squares.fill(NO_PIECE);
+	pieceSquares.fill(NO_SQUARE);
+	halfmoves = 0;
+	turn = Team::red;
+	kindBits.fill(0);
+	teamBits.fill(0);
+	fileBits.fill(0);
+	moveNumber_ = 1;
+	materialScore = 0;
+	zobristKey = 0;
 }
 
-Vector2d Board::toTeam(const Team team, const Vector2d p) {
-	assert(inBound(p));
-	return team==Team::black ?p :Vector2d{N_ROW-1-p.x, N_COL-1-p.y};
+std::uint64_t Board::computeKey() const {
+	std::uint64_t result = turn==Team::black ?Zobrist::keys.blackToMove :0;
+	for (int i=0; i<N_SQUARE; ++i) {
+		if (squares[i] != NO_PIECE) result ^= Zobrist::pieceKey(squares[i], i);
+	}
+	return result;
 }
 
-bool Board::inTeam(const Team team, const Vector2d p) {
-	assert(inBound(p));
-	return team==Team::black ?(p.x<N_ROW/2) :(p.x>=N_ROW/2);
+int Board::computeScore() const {
+	return Evaluator::sumSquares(squares.data());
 }
 
-bool Board::inBase(const Team team, const Vector2d p) {
-	assert(inBound(p));
-	const Vector2d pt{toTeam(team, p)};
-	return pt.x<=2 && 3<=pt.y && pt.y<=5;
+void Board::setSquare(const int index, const PieceId id) {
+	assert(squares[index] == NO_PIECE);
+	assert(id != NO_PIECE);
+
+	const Bitboard b = BitboardNS::bit(index);
+	const int team = static_cast<int>(PieceNS::teamOf(id));
+	squares[index] = id;
+	pieceSquares[PieceNS::slotOf(id)] = index;
+	kindBits[static_cast<int>(PieceNS::kindOf(id))] ^= b;
+	teamBits[team] ^= b;
+	fileBits[index%N_COL] ^= 1 << index/N_COL;
 }
 
-unique_ptr<Piece> &Board::pieceAt(const Vector2d p) {
-	assert(inBound(p));
-	return board[p.x][p.y];
+void Board::clearSquare(const int index) {
+	const PieceId id = squares[index];
+	assert(id != NO_PIECE);
+
+	const Bitboard b = BitboardNS::bit(index);
+	const int team = static_cast<int>(PieceNS::teamOf(id));
+	squares[index] = NO_PIECE;
+	pieceSquares[PieceNS::slotOf(id)] = NO_SQUARE;
+	kindBits[static_cast<int>(PieceNS::kindOf(id))] ^= b;
+	teamBits[team] ^= b;
+	fileBits[index%N_COL] ^= 1 << index/N_COL;
 }
 
-const unique_ptr<Piece> &Board::pieceAt(const Vector2d p) const {
+const Piece *Board::pieceAt(const Vector2d p) const {
 	assert(inBound(p));
-	return board[p.x][p.y];
+	const PieceId id = squares[indexOf(p)];
+	return id==NO_PIECE ?nullptr :&PieceNS::pieceOf(id);
 }
 
 bool Board::pieceExist(const Vector2d p) const {
 	assert(inBound(p));
-	return pieceAt(p).operator bool();
+	return squares[indexOf(p)] != NO_PIECE;
+}
+
+optional<Vector2d> Board::squareOf(const PieceId id) const {
+	assert(id != NO_PIECE);
+	const std::uint8_t i = pieceSquares[PieceNS::slotOf(id)];
+	if (i == NO_SQUARE) return nullopt;
+	return vectorOf(i);
 }
 
 optional<int> Board::countPiecesBetween(const Vector2d from, const Vector2d to) const {
+	CCHESS_PROBE(Instrument::countPiecesBetween);
 	assert(inBound(from));
 	assert(inBound(to));
 
@@ -68,74 +107,125 @@ optional<int> Board::countPiecesBetween(const Vector2d from, const Vector2d to)
 	if (diff.isZero()) return nullopt;
 	if (!diff.isOnAxis()) return nullopt;
 
-	const Vector2d delta = diff.quandrant();
-	int result = 0;
-	for (Vector2d p{from+delta}; p!=to; p+=delta) {
-		if (pieceExist(p)) {
-			++result;
-		}
+	// bits strictly between the two ends of the rank or file
+	const auto [line, lo, hi] = diff.x==0
+		?std::make_tuple(rankBits(from.x), std::min(from.y, to.y), std::max(from.y, to.y))
+		:std::make_tuple(fileBits[from.y], std::min(from.x, to.x), std::max(from.x, to.x));
+	const unsigned between = ((1u << hi) - 1) & ~((1u << (lo+1)) - 1);
+	return __builtin_popcount(line & between);
+}
+
+Bitboard Board::juTargets(const int index) const {
+	const int x = index/N_COL, y = index%N_COL;
+	const BitboardNS::LineAttacks &r = BitboardNS::rankAttacks(y, rankBits(x));
+	const BitboardNS::LineAttacks &f = BitboardNS::fileAttacks(x, fileBits[y]);
+	return BitboardNS::rankToBitboard(x, r.slide | r.firstBlocker) | BitboardNS::fileToBitboard(y, f.slide | f.firstBlocker);
+}
+
+Bitboard Board::paoTargets(const int index) const {
+	const int x = index/N_COL, y = index%N_COL;
+	const BitboardNS::LineAttacks &r = BitboardNS::rankAttacks(y, rankBits(x));
+	const BitboardNS::LineAttacks &f = BitboardNS::fileAttacks(x, fileBits[y]);
+	return BitboardNS::rankToBitboard(x, r.slide | r.secondBlocker) | BitboardNS::fileToBitboard(y, f.slide | f.secondBlocker);
+}
+
+Bitboard Board::targetsOf(const int i) const {
+	using PieceNS::Kind;
+	using BitboardNS::tables;
+	CCHESS_PROBE(Instrument::targetsOf);
+	assert(0<=i && i<N_SQUARE);
+	assert(squares[i] != NO_PIECE);
+
+	const PieceId id = squares[i];
+	const int team = static_cast<int>(PieceNS::teamOf(id));
+	Bitboard result = 0;
+	switch (PieceNS::kindOf(id)) {
+		case Kind::jiang: result = tables.jiangSteps[team][i]; break;
+		case Kind::shi: result = tables.shiSteps[team][i]; break;
+		case Kind::zu: result = tables.zuSteps[team][i]; break;
+		case Kind::ju: result = juTargets(i); break;
+		case Kind::pao: result = paoTargets(i); break;
+		case Kind::ma:
+			for (int j=0; j<4; ++j) {
+				const std::uint8_t leg = tables.maLeg[i][j];
+				if (leg!=BitboardNS::NO_SQUARE && squares[leg]==NO_PIECE) result |= tables.maByLeg[i][j];
+			}
+			break;
+		case Kind::xiang:
+			for (int j=0; j<4; ++j) {
+				const std::uint8_t eye = tables.xiangEye[i][j];
+				if (eye!=BitboardNS::NO_SQUARE && squares[eye]==NO_PIECE) result |= BitboardNS::bit(tables.xiangByEye[i][j]);
+			}
+			result &= tables.half[team];
+			break;
 	}
 
-	return result;
+	return result & ~teamBits[team];
 }
 
 bool Board::isMoveable(const Vector2d from, const Vector2d to) const {
+	CCHESS_PROBE(Instrument::isMoveable);
 	assert(inBound(from));
 	assert(inBound(to));
 	assert(from != to);
 	assert(pieceExist(from));
 
-	const unique_ptr<Piece> &pFrom = pieceAt(from);
-	const unique_ptr<Piece> &pTo = pieceAt(to);
-	if (!pFrom->isMoveCandidate(*this, from, to)) return false;
-	return !pieceExist(to) || pTo->team != pFrom->team;
+	const PieceId idFrom = idAt(from);
+	const PieceId idTo = idAt(to);
+	if (idTo!=NO_PIECE && PieceNS::teamOf(idTo)==PieceNS::teamOf(idFrom)) return false;
+	return MoveKernel::isMoveCandidate(PieceNS::kindOf(idFrom), PieceNS::teamOf(idFrom), *this, indexOf(from), indexOf(to));
 }
 
-void Board::makeMove(const Vector2d from, const Vector2d to) {
-	assert(isMoveable(from, to));
+Undo Board::makeMove(const Move m) {
+	assert(isMoveable(vectorOf(m.from), vectorOf(m.to)));
+
+	const PieceId id = squares[m.from];
+	const PieceId captured = squares[m.to];
+	std::uint64_t keyDelta = Zobrist::pieceKey(id, m.from) ^ Zobrist::pieceKey(id, m.to) ^ Zobrist::keys.blackToMove;
+	int scoreDelta = Evaluator::squareScore(id, m.to) - Evaluator::squareScore(id, m.from);
+	if (captured != NO_PIECE) {
+		keyDelta ^= Zobrist::pieceKey(captured, m.to);
+		scoreDelta -= Evaluator::squareScore(captured, m.to);
+		clearSquare(m.to);
+	}
+	clearSquare(m.from);
+	setSquare(m.to, id);
+	const Undo undo{m, captured, halfmoves, static_cast<std::int16_t>(scoreDelta), keyDelta};
+	if (turn == Team::black) ++moveNumber_;
+	halfmoves = captured!=NO_PIECE ?0 :halfmoves + 1;
+	turn = otherTeam(turn);
+	zobristKey ^= keyDelta;
+	materialScore += scoreDelta;
+	assert(zobristKey == computeKey());
+	assert(materialScore == computeScore());
+
+	return undo;
+}
 
-	pieceAt(to) = std::move(pieceAt(from));
+void Board::unmakeMove(const Undo undo) {
+	const Move m = undo.move;
+	assert(squares[m.from] == NO_PIECE);
+	assert(squares[m.to] != NO_PIECE);
+
+	const PieceId id = squares[m.to];
+	clearSquare(m.to);
+	setSquare(m.from, id);
+	if (undo.captured != NO_PIECE) setSquare(m.to, undo.captured);
+	turn = otherTeam(turn);
+	if (turn == Team::black) --moveNumber_;
+	halfmoves = undo.halfmoveClock;
+	zobristKey ^= undo.keyDelta;
+	materialScore -= undo.scoreDelta;
+	assert(zobristKey == computeKey());
+	assert(materialScore == computeScore());
 }
 
 void Board::print() const {
-	array<u32string, 2*N_ROW+1> strs {
-		{   U"一  二  三  四  五  六  七  八  九",
-			U"┌───┬───┬───┬───┬───┬───┬───┬───┐    -0",
-			U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
-			U"├───┼───┼───┼───┼───┼───┼───┼───┤    -1",
-			U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
-			U"├───╬───┼───┼───┼───┼───┼───╬───┤    -2",
-			U"│   │   │   │   │   │   │   │   │     ",
-			U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -3",
-			U"│   │   │   │   │   │   │   │   │     ",
-			U"├───┴───┴───┴───┴───┴───┴───┴───┤    -4",
-			U"│      楚河            漢界     │     ",
-			U"├───┬───┬───┬───┬───┬───┬───┬───┤    -5",
-			U"│   │   │   │   │   │   │   │   │     ",
-			U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -6",
-			U"│   │   │   │   │   │   │   │   │     ",
-			U"├───╬───┼───┼───┼───┼───┼───╬───┤    -7",
-			U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
-			U"├───┼───┼───┼───┼───┼───┼───┼───┤    -8",
-			U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
-			U"└───┴───┴───┴───┴───┴───┴───┴───┘    -9",
-			U"９  ８  ７  ６  ５  ４  ３  ２  １",
-		}};
-
-	for (int i=0; i<N_ROW; ++i) {
-		for (int j=N_COL-1; j>=0; --j) {
-			if (!pieceExist({i,j})) continue;
-			const Piece &p=*pieceAt({i,j});
-			const u32string coloredName = u32string(getTeamColor(p.team)) + u32string(p.getName()) + u32string(TerminalColor::restore);
-			strs[1+i*2].replace(j*4, 2, coloredName);
-		}
-	}
-
-	std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> cvt;
-
-	for (const u32string &s: strs) {
-		cout <<cvt.to_bytes(s) <<endl;
-	}
+	CCHESS_PROBE(Instrument::print);
+	BoardRenderer renderer;
+	const string_view frame = renderer.frame(*this);
+	cout.write(frame.data(), frame.size());
+	cout.flush();
 }
 
 namespace {
@@ -156,6 +246,7 @@ int Board::colToTeam(Team team, int col) {
 }
 
 vector<Vector2d> Board::getPiecesOfCol(Team team, char enPieceName, char col) const {
+	CCHESS_PROBE(Instrument::getPiecesOfCol);
 	int c = col-'1';
 	vector<Vector2d> result;
 	for (int i=N_ROW-1; i>=0; --i) {
@@ -208,30 +299,121 @@ optional<Vector2d> Board::parseMultiple(Team team, char kthInCol, char enPieceNa
 optional<Vector2d> Board::parseDestByDirection(Vector2d from, char direction, char c) const {
 	assert(pieceExist(from));
 
-	const unique_ptr<Piece> &p{pieceAt(from)};
-	assert(p.operator bool());
-	return p->destOfDirection(parseDirection(p->team, direction), from, c);
+	const PieceId id = idAt(from);
+	const Team team = PieceNS::teamOf(id);
+	const int to = MoveKernel::destOfDirection(PieceNS::kindOf(id), team, parseDirection(team, direction), indexOf(from), c);
+	if (to == NO_SQUARE) return nullopt;
+	return vectorOf(to);
 }
 
-namespace {
-	template <typename T> inline unique_ptr<T> m(Team t) { return make_unique<T>(t); }
+void Board::putPiece(const PieceNS::Kind kind, const Team team, const Vector2d p) {
+	assert(!pieceExist(p));
+
+	const int k = static_cast<int>(kind);
+	for (int s=PieceNS::firstSlotOfKind[k]; s<PieceNS::firstSlotOfKind[k+1]; ++s) {
+		const PieceId id = PieceNS::idOfSlot(team, s);
+		if (pieceSquares[PieceNS::slotOf(id)] != NO_SQUARE) continue;
+		setSquare(indexOf(p), id);
+		zobristKey ^= Zobrist::pieceKey(id, indexOf(p));
+		materialScore += Evaluator::squareScore(id, indexOf(p));
+		return;
+	}
+
+	assert(false); // more pieces of a kind than a team starts with
+}
+
+void Board::pack(std::uint8_t *out) const {
+	std::copy(pieceSquares.begin(), pieceSquares.end(), out);
+	if (turn == Team::black) out[0] |= 0x80;
+}
+
+Bitboard Board::allowedSquares(const PieceNS::Kind kind, const Team team) {
+	return MoveKernel::placements[static_cast<int>(team)*PieceNS::N_KIND + static_cast<int>(kind)];
+}
+
+optional<Board> Board::fromSlots(const array<std::uint8_t, PieceNS::N_SLOT> &slotSquares, const Team turn) {
+	// fills the members directly rather than through setSquare(), as loading positions
+	// in bulk is what this is for; built in place to save copying the board out
+	optional<Board> result{Board{}};
+	Board &board = *result;
+	board.pieceSquares = slotSquares;
+	if (turn == Team::black) {
+		board.turn = Team::black;
+		board.zobristKey = Zobrist::keys.blackToMove;
+	}
+
+	array<Bitboard, 2*PieceNS::N_KIND> bits{};
+	for (int team=0; team<2; ++team) {
+		for (int k=0; k<PieceNS::N_KIND; ++k) {
+			// one kind at a time, so that its bitboard builds up in a register
+			const int kind = team*PieceNS::N_KIND + k;
+			Bitboard squaresOfKind = 0;
+			for (int s=PieceNS::firstSlotOfKind[k]; s<PieceNS::firstSlotOfKind[k+1]; ++s) {
+				const int slot = team*PieceNS::N_SLOT_TEAM + s;
+				const int index = board.pieceSquares[slot];
+				if (index == NO_SQUARE) continue;
+				if (index>=N_SQUARE || board.squares[index]!=NO_PIECE) return nullopt;
+
+				board.squares[index] = PieceNS::FIRST_ID + slot;
+				squaresOfKind |= BitboardNS::bit(index);
+				board.fileBits[index%N_COL] |= 1 << index/N_COL;
+				board.zobristKey ^= Zobrist::keys.piece[kind][index];
+				board.materialScore += Evaluator::table[kind][index];
+			}
+			bits[kind] = squaresOfKind;
+		}
+	}
+	if (!board.finishLoading(bits)) return nullopt;
+	return result;
+}
+
+bool Board::finishLoading(const array<Bitboard, 2*PieceNS::N_KIND> &bits) {
+	for (int team=0; team<2; ++team) {
+		for (int k=0; k<PieceNS::N_KIND; ++k) {
+			const int kind = team*PieceNS::N_KIND + k;
+			if (bits[kind] & ~MoveKernel::placements[kind]) return false;
+			kindBits[k] |= bits[kind];
+			teamBits[team] |= bits[kind];
+		}
+	}
+
+	const int jiang = PieceNS::firstSlotOfKind[static_cast<int>(PieceNS::Kind::jiang)];
+	if (squareOfSlot(Team::red, jiang)==NO_SQUARE || squareOfSlot(Team::black, jiang)==NO_SQUARE) return false;
+	if (isInCheck(otherTeam(turn))) return false;
+
+	assert(zobristKey == computeKey());
+	assert(materialScore == computeScore());
+	return true;
+}
+
+optional<Board> Board::unpack(const std::uint8_t *in) {
+	static_assert(N_SQUARE <= 0x80, "the turn bit must not overlap a square index");
+
+	array<std::uint8_t, PACKED_SIZE> slotSquares;
+	std::copy(in, in+PACKED_SIZE, slotSquares.begin());
+	slotSquares[0] &= 0x7f;
+	return fromSlots(slotSquares, in[0]&0x80 ?Team::black :Team::red);
 }
 
 Board Board::makeStandardBoard() {
 	using namespace PieceNS;
 	constexpr Team r=Team::red;
 	constexpr Team b=Team::black;
+	constexpr Kind backRow[N_COL]{Kind::ju, Kind::ma, Kind::xiang, Kind::shi, Kind::jiang, Kind::shi, Kind::xiang, Kind::ma, Kind::ju};
+
+	Board board;
+	for (int j=0; j<N_COL; ++j) {
+		board.putPiece(backRow[j], b, {0,j});
+		board.putPiece(backRow[j], r, {N_ROW-1,j});
+	}
+	for (int j: {1, 7}) {
+		board.putPiece(Kind::pao, b, {2,j});
+		board.putPiece(Kind::pao, r, {7,j});
+	}
+	for (int j=0; j<N_COL; j+=2) {
+		board.putPiece(Kind::zu, b, {3,j});
+		board.putPiece(Kind::zu, r, {6,j});
+	}
 
-	return Board{{{
-		{   m<Ju>(b),    m<Ma>(b), m<Xiang>(b),   m<Shi>(b), m<Jiang>(b),   m<Shi>(b), m<Xiang>(b),    m<Ma>(b),    m<Ju>(b)}
-		,{   nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr}
-		,{   nullptr,   m<Pao>(b),     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,   m<Pao>(b),     nullptr}
-		,{  m<Zu>(b),     nullptr,    m<Zu>(b),     nullptr,    m<Zu>(b),     nullptr,    m<Zu>(b),     nullptr,    m<Zu>(b)}
-		,{   nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr}
-		,{   nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr}
-		,{  m<Zu>(r),     nullptr,    m<Zu>(r),     nullptr,    m<Zu>(r),     nullptr,    m<Zu>(r),     nullptr,    m<Zu>(r)}
-		,{   nullptr,   m<Pao>(r),     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,   m<Pao>(r),     nullptr}
-		,{   nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr}
-		,{  m<Ju>(r),    m<Ma>(r), m<Xiang>(r),   m<Shi>(r), m<Jiang>(r),   m<Shi>(r), m<Xiang>(r),    m<Ma>(r),    m<Ju>(r)}
-	}}};
+	return board;
 }
@@ -0,0 +1,162 @@
+#include "BoardRenderer.hpp"
+#include "color.hpp"
+
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+using PieceNS::Kind;
+using PieceNS::N_KIND;
+using std::array;
+using std::string;
+using std::string_view;
+using std::u32string_view;
+
+namespace {
+	constexpr int N_LINE = 2*Board::N_ROW + 1;
+
+	constexpr array<u32string_view, N_LINE> lines{
+		{   U"一  二  三  四  五  六  七  八  九",
+			U"┌───┬───┬───┬───┬───┬───┬───┬───┐    -0",
+			U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
+			U"├───┼───┼───┼───┼───┼───┼───┼───┤    -1",
+			U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
+			U"├───╬───┼───┼───┼───┼───┼───╬───┤    -2",
+			U"│   │   │   │   │   │   │   │   │     ",
+			U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -3",
+			U"│   │   │   │   │   │   │   │   │     ",
+			U"├───┴───┴───┴───┴───┴───┴───┴───┤    -4",
+			U"│      楚河            漢界     │     ",
+			U"├───┬───┬───┬───┬───┬───┬───┬───┤    -5",
+			U"│   │   │   │   │   │   │   │   │     ",
+			U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -6",
+			U"│   │   │   │   │   │   │   │   │     ",
+			U"├───╬───┼───┼───┼───┼───┼───╬───┤    -7",
+			U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
+			U"├───┼───┼───┼───┼───┼───┼───┼───┤    -8",
+			U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
+			U"└───┴───┴───┴───┴───┴───┴───┴───┘    -9",
+			U"９  ８  ７  ６  ５  ４  ３  ２  １",
+		}};
+
+	void appendUtf8(string &out, const u32string_view s) {
+		for (const char32_t c: s) {
+			if (c < 0x80) {
+				out += static_cast<char>(c);
+			} else if (c < 0x800) {
+				out += static_cast<char>(0xc0 | c>>6);
+				out += static_cast<char>(0x80 | (c & 0x3f));
+			} else if (c < 0x10000) {
+				out += static_cast<char>(0xe0 | c>>12);
+				out += static_cast<char>(0x80 | (c>>6 & 0x3f));
+				out += static_cast<char>(0x80 | (c & 0x3f));
+			} else {
+				out += static_cast<char>(0xf0 | c>>18);
+				out += static_cast<char>(0x80 | (c>>12 & 0x3f));
+				out += static_cast<char>(0x80 | (c>>6 & 0x3f));
+				out += static_cast<char>(0x80 | (c & 0x3f));
+			}
+		}
+	}
+
+	// the empty board as UTF-8, where each square's piece goes, and the pieces as drawn there
+	struct Template {
+		string text;
+		// bytes of text a piece on the square replaces: the two characters at column 4*y
+		array<std::uint16_t, Board::N_SQUARE> cellBegin, cellEnd;
+		// the colored name of each team*N_KIND + kind
+		array<string, 2*N_KIND> names;
+
+		Template() {
+			for (int line=0; line<N_LINE; ++line) {
+				const int x = (line - 1) / 2;
+				for (int col=0; col<static_cast<int>(lines[line].size()); ++col) {
+					const bool cell = line%2==1 && col%4==0 && col/4<Board::N_COL;
+					if (cell) cellBegin[Board::indexOf({x, col/4})] = text.size();
+					appendUtf8(text, lines[line].substr(col, 1));
+					if (cell) {
+						appendUtf8(text, lines[line].substr(col+1, 1));
+						cellEnd[Board::indexOf({x, col/4})] = text.size();
+						++col;
+					}
+				}
+				text += '\n';
+			}
+
+			for (const Team team: {Team::red, Team::black}) {
+				for (int k=0; k<N_KIND; ++k) {
+					string &name = names[static_cast<int>(team)*N_KIND + k];
+					appendUtf8(name, getTeamColor(team));
+					appendUtf8(name, PieceNS::pieceOf(static_cast<Kind>(k), team).getName());
+					appendUtf8(name, TerminalColor::restore);
+				}
+			}
+		}
+	};
+
+	const Template &emptyBoard() {
+		static const Template t;
+		return t;
+	}
+}
+
+void BoardRenderer::append(const string_view s) {
+	assert(n + s.size() <= CAPACITY);
+	std::memcpy(buffer.data() + n, s.data(), s.size());
+	n += s.size();
+}
+
+void BoardRenderer::appendCell(const int square, const Board::PieceId id) {
+	const Template &t = emptyBoard();
+	if (id == Board::NO_PIECE) {
+		append(string_view{t.text}.substr(t.cellBegin[square], t.cellEnd[square] - t.cellBegin[square]));
+	} else {
+		append(t.names[static_cast<int>(PieceNS::teamOf(id))*N_KIND + static_cast<int>(PieceNS::kindOf(id))]);
+	}
+}
+
+void BoardRenderer::appendCursor(const int row, const int col) {
+	// ESC [ row ; col H, both at most a few digits
+	assert(n + 16 <= CAPACITY);
+	buffer[n++] = '\033';
+	buffer[n++] = '[';
+	n = std::to_chars(buffer.data() + n, buffer.data() + CAPACITY, row).ptr - buffer.data();
+	buffer[n++] = ';';
+	n = std::to_chars(buffer.data() + n, buffer.data() + CAPACITY, col).ptr - buffer.data();
+	buffer[n++] = 'H';
+}
+
+string_view BoardRenderer::frame(const Board &board) {
+	const Template &t = emptyBoard();
+	n = 0;
+	size_t pos = 0;
+	for (int i=0; i<Board::N_SQUARE; ++i) {
+		shown[i] = board.idAt(Board::vectorOf(i));
+		append(string_view{t.text}.substr(pos, t.cellBegin[i] - pos));
+		appendCell(i, shown[i]);
+		pos = t.cellEnd[i];
+	}
+	append(string_view{t.text}.substr(pos));
+	drawn = true;
+	return {buffer.data(), n};
+}
+
+string_view BoardRenderer::update(const Board &board) {
+	if (!drawn) return frame(board);
+
+	n = 0;
+	for (int i=0; i<Board::N_SQUARE; ++i) {
+		const Board::PieceId id = board.idAt(Board::vectorOf(i));
+		if (id == shown[i]) continue;
+		shown[i] = id;
+		const Vector2d p = Board::vectorOf(i);
+		appendCursor(top + 1 + 2*p.x, left + 4*p.y);
+		appendCell(i, id);
+	}
+	if (n > 0) appendCursor(top + N_LINE, 1);
+	return {buffer.data(), n};
+}
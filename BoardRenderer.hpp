@@ -0,0 +1,41 @@
+#ifndef BOARD_RENDERER_HPP
+#define BOARD_RENDERER_HPP
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "Board.hpp"
+
+// The board as Board::print() shows it, as UTF-8 in a buffer of its own: the empty board
+// is encoded once, and a frame copies it with the colored name of each piece spliced in,
+// so drawing allocates nothing and the frame goes out in one write.
+//
+// update() draws only the squares whose piece changed since the last frame: a cursor move
+// and the cell for each, then a move back below the board. It assumes that last frame was
+// drawn with its top-left corner at `top`, `left` of the terminal, counted from 1.
+class BoardRenderer {
+	public:
+		static constexpr std::size_t CAPACITY = 4096;
+
+	private:
+		std::array<char, CAPACITY> buffer;
+		std::size_t n = 0;
+		std::array<Board::PieceId, Board::N_SQUARE> shown;
+		bool drawn = false;
+		int top, left;
+
+		void append(std::string_view s);
+		void appendCell(int square, Board::PieceId id);
+		void appendCursor(int row, int col);
+
+	public:
+		explicit BoardRenderer(int top_ = 1, int left_ = 1): top(top_), left(left_) { }
+
+		// the whole board, valid until the next frame() or update()
+		std::string_view frame(const Board &board);
+		// what turns the last frame into `board`, a frame if there was none
+		std::string_view update(const Board &board);
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "Evaluator.hpp"
+#include "Board.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+using std::array;
+using std::int16_t;
+using std::uint16_t;
+
+namespace Evaluator {
+	namespace {
+		// From the owner's side: row 0 is its own back rank, row 9 the enemy's.
+		using Pst = array<array<int16_t, 9>, 10>;
+
+		constexpr Pst jiangPst{{
+			{0, 0, 0,  -2,   0,  -2, 0, 0, 0},
+			{0, 0, 0,  -8,  -6,  -8, 0, 0, 0},
+			{0, 0, 0, -14, -12, -14, 0, 0, 0},
+		}};
+
+		constexpr Pst shiPst{{
+			{0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 0, 3, 0, 0, 0, 0},
+		}};
+
+		constexpr Pst xiangPst{{
+			{ 0, 0, 0, 0, 0, 0, 0, 0,  0},
+			{ 0, 0, 0, 0, 0, 0, 0, 0,  0},
+			{-2, 0, 0, 0, 3, 0, 0, 0, -2},
+			{ 0, 0, 0, 0, 0, 0, 0, 0,  0},
+			{ 0, 0,-2, 0, 0, 0,-2, 0,  0},
+		}};
+
+		constexpr Pst maPst{{
+			{ 0, -4,  0,  0,   0,  0,  0, -4,  0},
+			{ 0,  2,  4,  4, -10,  4,  4,  2,  0},
+			{ 4,  2,  8,  8,   4,  8,  8,  2,  4},
+			{ 2,  6,  8,  6,  10,  6,  8,  6,  2},
+			{ 4, 12, 16, 14,  12, 14, 16, 12,  4},
+			{ 6, 16, 14, 18,  16, 18, 14, 16,  6},
+			{ 8, 24, 18, 24,  20, 24, 18, 24,  8},
+			{12, 14, 16, 20,  18, 20, 16, 14, 12},
+			{ 4, 10, 28, 16,   8, 16, 28, 10,  4},
+			{ 4,  8, 16, 12,   4, 12, 16,  8,  4},
+		}};
+
+		constexpr Pst juPst{{
+			{-6,  6,  4, 12,  0, 12,  4,  6, -6},
+			{ 5,  8,  6, 12,  0, 12,  6,  8,  5},
+			{-2,  8,  4, 12, 12, 12,  4,  8, -2},
+			{ 4,  9,  4, 12, 14, 12,  4,  9,  4},
+			{ 8, 12, 12, 14, 15, 14, 12, 12,  8},
+			{ 8, 11, 11, 14, 15, 14, 11, 11,  8},
+			{ 6, 13, 13, 16, 16, 16, 13, 13,  6},
+			{ 6,  8,  7, 14, 16, 14,  7,  8,  6},
+			{ 6, 12,  9, 16, 33, 16,  9, 12,  6},
+			{ 6,  8,  7, 13, 14, 13,  7,  8,  6},
+		}};
+
+		constexpr Pst paoPst{{
+			{ 0, 0,  2,   6,   6,   6,  2, 0,  0},
+			{ 0, 2,  4,   6,   6,   6,  4, 2,  0},
+			{ 4, 0,  8,   6,  10,   6,  8, 0,  4},
+			{ 0, 0,  0,   2,   4,   2,  0, 0,  0},
+			{-2, 0,  4,   2,   6,   2,  4, 0, -2},
+			{ 0, 0,  0,   2,   8,   2,  0, 0,  0},
+			{ 0, 0, -2,   4,  10,   4, -2, 0,  0},
+			{ 2, 2,  0, -10,  -8, -10,  0, 2,  2},
+			{ 2, 2,  0,  -4, -14,  -4,  0, 2,  2},
+			{ 6, 4,  0, -10, -12, -10,  0, 4,  6},
+		}};
+
+		constexpr Pst zuPst{{
+			{ 0,  0,  0,  0,   0,  0,  0,  0,  0},
+			{ 0,  0,  0,  0,   0,  0,  0,  0,  0},
+			{ 0,  0,  0,  0,   0,  0,  0,  0,  0},
+			{ 0,  0, -2,  0,   4,  0, -2,  0,  0},
+			{ 2,  0,  8,  0,   8,  0,  8,  0,  2},
+			{ 6, 12, 18, 18,  20, 18, 18, 12,  6},
+			{10, 20, 30, 34,  40, 34, 30, 20, 10},
+			{14, 26, 42, 60,  80, 60, 42, 26, 14},
+			{18, 36, 56, 80, 120, 80, 56, 36, 18},
+			{ 0,  3,  6,  9,  12,  9,  6,  3,  0},
+		}};
+
+		// in PieceNS::Kind order
+		constexpr array<const Pst *, PieceNS::N_KIND> psts{&jiangPst, &shiPst, &xiangPst, &maPst, &juPst, &paoPst, &zuPst};
+
+		constexpr Table makeTable() {
+			Table t{};
+			for (int team=0; team<2; ++team) {
+				for (int kind=0; kind<PieceNS::N_KIND; ++kind) {
+					for (int x=0; x<10; ++x) {
+						for (int y=0; y<9; ++y) {
+							// same as Board::toTeam(): red sees the board rotated by 180 degrees
+							const int square = team==static_cast<int>(Team::black) ?x*9 + y :(9-x)*9 + (8-y);
+							const int value = materialValue[kind] + (*psts[kind])[x][y];
+							t[team*PieceNS::N_KIND + kind][square] = team==static_cast<int>(Team::red) ?value :-value;
+						}
+					}
+				}
+			}
+			return t;
+		}
+
+		typedef std::uint8_t U8x16 __attribute__((vector_size(16)));
+		typedef uint16_t U16x16 __attribute__((vector_size(32)));
+		typedef int16_t I16x16 __attribute__((vector_size(32)));
+		constexpr int LANES = 16;
+		constexpr int N_VECTOR = N_SQUARE_PADDED / LANES;
+		constexpr int N_PLANE = 2*PieceNS::N_KIND;
+
+		constexpr array<uint16_t, N_PLANE> planeFirstId{[]{
+			array<uint16_t, N_PLANE> result{};
+			for (int plane=0; plane<N_PLANE; ++plane) {
+				const int kind = plane % PieceNS::N_KIND;
+				result[plane] = PieceNS::idOfSlot(static_cast<Team>(plane / PieceNS::N_KIND), PieceNS::firstSlotOfKind[kind]);
+			}
+			return result;
+		}()};
+
+		constexpr array<uint16_t, N_PLANE> planeIdCount{[]{
+			array<uint16_t, N_PLANE> result{};
+			for (int plane=0; plane<N_PLANE; ++plane) {
+				const int kind = plane % PieceNS::N_KIND;
+				result[plane] = PieceNS::firstSlotOfKind[kind+1] - PieceNS::firstSlotOfKind[kind];
+			}
+			return result;
+		}()};
+	}
+
+	const Table table = makeTable();
+
+	// cloned for AVX2 where the CPU has it, plain SSE2 otherwise
+	__attribute__((target_clones("avx2", "default")))
+	int sumSquares(const std::uint8_t *squares) {
+		std::uint8_t padded[N_SQUARE_PADDED]{};
+		std::memcpy(padded, squares, N_SQUARE);
+
+		// every (team, kind) owns a contiguous range of ids, so one unsigned compare
+		// per vector selects its pieces
+		U16x16 first[N_PLANE], count[N_PLANE];
+		for (int plane=0; plane<N_PLANE; ++plane) {
+			first[plane] = U16x16{} + planeFirstId[plane];
+			count[plane] = U16x16{} + planeIdCount[plane];
+		}
+
+		I16x16 sum{};
+		for (int v=0; v<N_VECTOR; ++v) {
+			U8x16 narrow;
+			std::memcpy(&narrow, &padded[v*LANES], sizeof narrow);
+			const U16x16 ids = __builtin_convertvector(narrow, U16x16);
+
+			for (int plane=0; plane<N_PLANE; ++plane) {
+				I16x16 values;
+				std::memcpy(&values, &table[plane][v*LANES], sizeof values);
+				sum += (ids - first[plane] < count[plane]) & values;
+			}
+		}
+
+		int result = 0;
+		for (int l=0; l<LANES; ++l) result += sum[l];
+		return result;
+	}
+
+	int evaluate(const Board &board) {
+		return board.sideToMove()==Team::red ?board.score() :-board.score();
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "Piece.hpp"
+#include "Square.hpp"
+#include "Team.hpp"
+
+class Board;
+
+// Material plus a per-kind piece-square bonus. Board keeps the sum of squareScore() over
+// its pieces up to date in makeMove()/unmakeMove(); sumSquares() recomputes it from scratch.
+namespace Evaluator {
+	using SquareNS::N_SQUARE;
+	// rounded up to a whole number of SIMD vectors
+	constexpr int N_SQUARE_PADDED = 96;
+
+	constexpr std::array<int, PieceNS::N_KIND> materialValue{
+		/*jiang*/ 0, /*shi*/ 200, /*xiang*/ 200, /*ma*/ 400, /*ju*/ 900, /*pao*/ 450, /*zu*/ 100,
+	};
+
+	// material plus position of every (team, kind) on every square, positive for red
+	using Table = std::array<std::array<std::int16_t, N_SQUARE_PADDED>, 2*PieceNS::N_KIND>;
+	extern const Table table;
+
+	inline int squareScore(std::uint8_t id, int square) {
+		return table[static_cast<int>(PieceNS::teamOf(id))*PieceNS::N_KIND + static_cast<int>(PieceNS::kindOf(id))][square];
+	}
+
+	// red-positive sum of squareScore() over a board of Board::PieceId, one per square
+	int sumSquares(const std::uint8_t *squares);
+
+	// the score from the point of view of the side to move
+	int evaluate(const Board &board);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#include "Board.hpp"
+#include "Evaluator.hpp"
+#include "Piece.hpp"
+#include "Zobrist.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using std::array;
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::string;
+using std::string_view;
+
+namespace {
+	using PieceNS::N_KIND;
+
+	// the red letter of each kind in PieceNS::Kind order; black's are in lower case
+	constexpr array<char, N_KIND> fenLetters{'K', 'A', 'B', 'N', 'R', 'C', 'P'};
+
+	// what a character of the placement field does, so that parsing it takes no branch on
+	// the character, which a mix of pieces and digits would keep mispredicting
+	struct FenChar {
+		std::uint8_t piece;   // team*N_KIND + kind, NONE for a digit or '/'
+		std::uint8_t advance; // columns taken
+		bool slash;           // ends a row
+		bool invalid;         // has no place in the field
+	};
+	constexpr int NONE = 2*N_KIND;
+
+	// H and E are accepted for N and B, as some programs write them
+	constexpr array<FenChar, 256> makeFenChars() {
+		array<FenChar, 256> result{};
+		for (FenChar &c: result) c = {NONE, 0, false, true};
+		for (int d=1; d<=9; ++d) result['0' + d] = {NONE, static_cast<std::uint8_t>(d), false, false};
+		result['/'] = {NONE, 0, true, false};
+		for (int k=0; k<N_KIND; ++k) {
+			result[fenLetters[k]] = {static_cast<std::uint8_t>(k), 1, false, false};
+			result[fenLetters[k] - 'A' + 'a'] = {static_cast<std::uint8_t>(N_KIND + k), 1, false, false};
+		}
+		result['H'] = result['N'];
+		result['h'] = result['n'];
+		result['E'] = result['B'];
+		result['e'] = result['b'];
+		return result;
+	}
+
+	constexpr array<FenChar, 256> fenChars = makeFenChars();
+
+	// the first slot of each team*N_KIND + kind
+	constexpr array<std::uint8_t, 2*N_KIND> firstSlots = []{
+		array<std::uint8_t, 2*N_KIND> result{};
+		for (int i=0; i<2*N_KIND; ++i) result[i] = i/N_KIND*PieceNS::N_SLOT_TEAM + PieceNS::firstSlotOfKind[i%N_KIND];
+		return result;
+	}();
+
+	// one past the last slot of each team*N_KIND + kind
+	constexpr array<std::uint8_t, 2*N_KIND> endSlots = []{
+		array<std::uint8_t, 2*N_KIND> result{};
+		for (int i=0; i<2*N_KIND; ++i) result[i] = i/N_KIND*PieceNS::N_SLOT_TEAM + PieceNS::firstSlotOfKind[i%N_KIND + 1];
+		return result;
+	}();
+
+	// the next space-separated field of s from pos, empty at the end
+	string_view nextField(const string_view s, size_t &pos) {
+		while (pos<s.size() && s[pos]==' ') ++pos;
+		const size_t start = pos;
+		while (pos<s.size() && s[pos]!=' ') ++pos;
+		return s.substr(start, pos-start);
+	}
+
+	optional<std::uint16_t> parseCounter(const string_view field) {
+		std::uint16_t result;
+		const auto [end, error] = std::from_chars(field.data(), field.data()+field.size(), result);
+		if (error!=std::errc{} || end!=field.data()+field.size()) return nullopt;
+		return result;
+	}
+}
+
+optional<Board> Board::fromFen(const string_view fen) {
+	// one character per square and a '/' between rows at the most
+	constexpr size_t MAX_PLACEMENT = N_SQUARE + N_ROW - 1;
+	const size_t length = std::min(fen.find(' '), fen.size());
+	if (length > MAX_PLACEMENT) return nullopt;
+
+	// the pieces in the order of the field, with every character that is not a piece written
+	// past the last one as NONE
+	array<std::uint8_t, MAX_PLACEMENT> placedSquares, placedPieces;
+	int n = 0, square = 0, row = 0, col = 0;
+	bool malformed = false;
+	for (size_t i=0; i<length; ++i) {
+		const FenChar c = fenChars[static_cast<unsigned char>(fen[i])];
+		malformed |= c.invalid | (c.slash & (col!=N_COL));
+		col = (col + c.advance) & -!c.slash;
+		malformed |= col > N_COL;
+		row += c.slash;
+		placedSquares[n] = square;
+		placedPieces[n] = c.piece;
+		n += c.piece!=NONE;
+		square += c.advance;
+	}
+	size_t pos = length;
+	if (malformed || row!=N_ROW-1 || col!=N_COL) return nullopt;
+
+	const string_view side = nextField(fen, pos);
+	if (side!="w" && side!="r" && side!="b") return nullopt;
+
+	std::uint16_t halfmoves = 0, moveNumber = 1;
+	if (!nextField(fen, pos).empty()) {
+		nextField(fen, pos);
+		const string_view clock = nextField(fen, pos), number = nextField(fen, pos);
+		if (!clock.empty()) {
+			const optional<std::uint16_t> h = parseCounter(clock);
+			if (!h.has_value()) return nullopt;
+			halfmoves = *h;
+		}
+		if (!number.empty()) {
+			const optional<std::uint16_t> n = parseCounter(number);
+			if (!n.has_value() || *n==0) return nullopt;
+			moveNumber = *n;
+		}
+	}
+	if (!nextField(fen, pos).empty()) return nullopt;
+
+	// filled in directly, as fromSlots() does, but over the pieces present rather than
+	// every slot; the pieces of a kind take its slots in board order
+	optional<Board> result{Board{}};
+	Board &board = *result;
+	if (side == "b") {
+		board.turn = Team::black;
+		board.zobristKey = Zobrist::keys.blackToMove;
+	}
+	board.halfmoves = halfmoves;
+	board.moveNumber_ = moveNumber;
+
+	array<std::uint8_t, 2*N_KIND> nextSlot = firstSlots;
+	std::uint64_t key = board.zobristKey;
+	std::int32_t score = 0;
+	array<Bitboard, 2*N_KIND> bits{};
+	for (int i=0; i<n; ++i) {
+		const int piece = placedPieces[i], index = placedSquares[i];
+		const int slot = nextSlot[piece]++;
+		// more pieces of a kind than a team starts with
+		if (slot == endSlots[piece]) return nullopt;
+		board.squares[index] = PieceNS::FIRST_ID + slot;
+		board.pieceSquares[slot] = index;
+		bits[piece] |= BitboardNS::bit(index);
+		board.fileBits[index%N_COL] |= 1 << index/N_COL;
+		key ^= Zobrist::keys.piece[piece][index];
+		score += Evaluator::table[piece][index];
+	}
+	board.zobristKey = key;
+	board.materialScore = score;
+	if (!board.finishLoading(bits)) result.reset();
+	return result;
+}
+
+int Board::writeFen(char *out) const {
+	char *p = out;
+	for (int row=0; row<N_ROW; ++row) {
+		int empty = 0;
+		for (int col=0; col<N_COL; ++col) {
+			const PieceId id = squares[row*N_COL + col];
+			if (id == NO_PIECE) {
+				++empty;
+				continue;
+			}
+			if (empty > 0) *p++ = '0' + empty;
+			empty = 0;
+			const char letter = fenLetters[static_cast<int>(PieceNS::kindOf(id))];
+			*p++ = PieceNS::teamOf(id)==Team::red ?letter :letter - 'A' + 'a';
+		}
+		if (empty > 0) *p++ = '0' + empty;
+		if (row < N_ROW-1) *p++ = '/';
+	}
+
+	for (const char c: {' ', turn==Team::red ?'w' :'b', ' ', '-', ' ', '-', ' '}) *p++ = c;
+	p = std::to_chars(p, out+MAX_FEN_SIZE, halfmoves).ptr;
+	*p++ = ' ';
+	p = std::to_chars(p, out+MAX_FEN_SIZE, moveNumber_).ptr;
+	return p - out;
+}
+
+string Board::fen() const {
+	char buffer[MAX_FEN_SIZE];
+	return string(buffer, writeFen(buffer));
+}
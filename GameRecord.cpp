@@ -0,0 +1,231 @@
+#include "GameRecord.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::string_view;
+using std::vector;
+
+namespace GameRecord {
+	namespace {
+		bool isSpace(const char c) { return c==' ' || c=='\t' || c=='\r' || c=='\n'; }
+
+		string_view trimLeft(string_view s) {
+			while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+			return s;
+		}
+
+		optional<Result> parseResult(const string_view s) {
+			if (s == "1-0") return Result::redWin;
+			if (s == "0-1") return Result::blackWin;
+			if (s == "1/2-1/2") return Result::draw;
+			if (s == "*") return Result::unknown;
+			return nullopt;
+		}
+
+		// releasing pages this often keeps the mapping's resident size flat
+		constexpr size_t RELEASE_INTERVAL = 64 << 20;
+
+		// validation splits the archive into chunks of about this many bytes per thread,
+		// small enough for idle threads to have something to steal
+		constexpr size_t CHUNKS_PER_THREAD = 16;
+		constexpr size_t MIN_CHUNK = 64 << 10;
+
+		size_t lineEnd(const string_view data, const size_t p) {
+			const size_t eol = data.find('\n', p);
+			return eol==string_view::npos ?data.size() :eol + 1;
+		}
+
+		enum class Line { none, blank, tag, moves };
+
+		Line lineKind(const string_view line) {
+			const string_view s = trimLeft(line);
+			return s.empty() ?Line::blank :s.front()=='[' ?Line::tag :Line::moves;
+		}
+	}
+
+	optional<Game> Reader::next() {
+		while (pos<data.size() && lineKind(data.substr(pos, lineEnd(data, pos)-pos))==Line::blank) pos = lineEnd(data, pos);
+		if (pos >= data.size()) return nullopt;
+
+		const size_t start = pos;
+		bool sawMoves = false;
+		while (pos < data.size()) {
+			const size_t eol = lineEnd(data, pos);
+			if (lineKind(data.substr(pos, eol-pos)) != Line::moves) {
+				if (sawMoves) break;
+			} else {
+				sawMoves = true;
+			}
+			pos = eol;
+		}
+
+		return Game{data.substr(start, pos-start), start};
+	}
+
+	size_t nextGameStart(const string_view data, const size_t offset) {
+		if (offset == 0) return 0;
+		if (offset >= data.size()) return data.size();
+		size_t p = data[offset-1]=='\n' ?offset :lineEnd(data, offset);
+
+		// Reader ends a game at a blank or tag line once the game has moves, so what
+		// matters is the last non-blank line before p and whether blanks follow it
+		Line last = Line::none;
+		bool blank = false;
+		for (size_t q=p; q>0; ) {
+			const size_t start = q>=2 ?data.rfind('\n', q-2) + 1 :0;
+			last = lineKind(data.substr(start, q-start));
+			if (last != Line::blank) break;
+			blank = true;
+			last = Line::none;
+			q = start;
+		}
+
+		while (p < data.size()) {
+			const size_t eol = lineEnd(data, p);
+			const Line kind = lineKind(data.substr(p, eol-p));
+			if (kind == Line::blank) {
+				blank = true;
+			} else {
+				if (last==Line::none || (last==Line::moves && (blank || kind==Line::tag))) return p;
+				last = kind;
+				blank = false;
+			}
+			p = eol;
+		}
+		return data.size();
+	}
+
+	optional<string_view> MoveTokens::next() {
+		while (true) {
+			while (pos<text.size() && isSpace(text[pos])) ++pos;
+			if (pos >= text.size()) return nullopt;
+
+			const char c = text[pos];
+			if (c == '[') {
+				const size_t end = std::min(text.find(']', pos), text.size());
+				const string_view tag = text.substr(pos+1, end-pos-1);
+				if (tag.substr(0, 7) == "Result ") {
+					const size_t open = tag.find('"'), close = tag.rfind('"');
+					if (open != close) {
+						if (const optional<Result> r = parseResult(tag.substr(open+1, close-open-1))) result_ = *r;
+					}
+				}
+				pos = end + 1;
+				continue;
+			}
+			if (c == '{') {
+				pos = std::min(text.find('}', pos), text.size()) + 1;
+				continue;
+			}
+			if (c == ';') {
+				pos = std::min(text.find('\n', pos), text.size());
+				continue;
+			}
+
+			size_t end = pos;
+			while (end<text.size() && !isSpace(text[end]) && text[end]!='{' && text[end]!=';') ++end;
+			string_view token = text.substr(pos, end-pos);
+			pos = end;
+
+			// a move number, possibly glued to the move as in "1.p2p5"
+			size_t digits = 0;
+			while (digits<token.size() && '0'<=token[digits] && token[digits]<='9') ++digits;
+			if (digits>0 && digits<token.size() && token[digits]=='.') {
+				while (digits<token.size() && token[digits]=='.') ++digits;
+				token.remove_prefix(digits);
+				if (token.empty()) continue;
+			}
+
+			if (const optional<Result> r = parseResult(token)) {
+				result_ = *r;
+				continue;
+			}
+			return token;
+		}
+	}
+
+	optional<ImportStats> importArchive(const char *path, std::ostream &log) {
+		const optional<MappedFile> file = MappedFile::open(path);
+		if (!file.has_value()) return nullopt;
+
+		const auto begin = std::chrono::steady_clock::now();
+		ImportStats stats;
+		Reader reader{file->view()};
+		size_t released = 0;
+		for (std::uint64_t index=0; const optional<Game> game = reader.next(); ++index) {
+			Board board = Board::makeStandardBoard();
+			const Replay r = replay(*game, board);
+			stats.moves += r.plies;
+			if (r.ok()) {
+				++stats.games;
+			} else {
+				++stats.malformed;
+				log <<"game " <<index+1 <<" at byte " <<game->offset <<": " <<Notation::errorName(r.error.error)
+					<<" in move " <<r.error.move+1 <<" '" <<r.failedMove <<"', skipped\n";
+			}
+
+			if (reader.position() - released >= RELEASE_INTERVAL) {
+				released = reader.position();
+				file->release(released);
+			}
+		}
+
+		stats.bytes = file->size();
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		return stats;
+	}
+
+	optional<ValidationReport> validateArchive(const char *path, const int threads) {
+		const optional<MappedFile> file = MappedFile::open(path);
+		if (!file.has_value()) return nullopt;
+
+		const auto begin = std::chrono::steady_clock::now();
+		const string_view data = file->view();
+		const size_t chunkBytes = std::max(MIN_CHUNK, data.size() / (threads*CHUNKS_PER_THREAD) + 1);
+		vector<size_t> bounds{0};
+		while (bounds.back() < data.size()) bounds.push_back(nextGameStart(data, bounds.back() + chunkBytes));
+
+		// each chunk fills its own slot, so the order of the results does not depend on
+		// which thread got which chunk
+		const size_t nChunks = bounds.size() - 1;
+		vector<vector<Validation>> results(nChunks);
+		vector<std::uint64_t> moves(nChunks);
+		{
+			ThreadPool pool{threads};
+			for (size_t i=0; i<nChunks; ++i) {
+				pool.submit([&, i] {
+					Reader reader{data.substr(bounds[i], bounds[i+1]-bounds[i])};
+					while (const optional<Game> game = reader.next()) {
+						Board board = Board::makeStandardBoard();
+						const Replay r = replay(*game, board);
+						results[i].push_back(Validation{bounds[i] + game->offset, board.key(), r.plies, r.error.error});
+						moves[i] += r.plies;
+					}
+				});
+			}
+			pool.wait();
+		}
+
+		ValidationReport report;
+		for (size_t i=0; i<nChunks; ++i) {
+			report.games.insert(report.games.end(), results[i].begin(), results[i].end());
+			report.moves += moves[i];
+		}
+		report.bytes = file->size();
+		report.threads = threads;
+		report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		return report;
+	}
+}
@@ -0,0 +1,139 @@
+#ifndef GAME_RECORD_HPP
+#define GAME_RECORD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "Board.hpp"
+#include "Notation.hpp"
+
+// PGN-style game archives with moves in the Notation format:
+//
+//   [Event "..."]
+//   [Result "1-0"]
+//
+//   1. p2p5 p8p5 2. m2j3 {a comment} m8j7 ... 1-0
+//
+// Tag lines are optional. A game ends at the first blank line after its moves, or where
+// the tags of the next game begin. Move numbers, {} and ; comments and the result are
+// skipped when reading moves. "1-0" is a win for red, who moves first.
+namespace GameRecord {
+	enum class Result { unknown, redWin, blackWin, draw };
+
+	struct Game {
+		std::string_view text;
+		std::size_t offset; // of text within the archive
+	};
+
+	// splits an archive into games, pointing into it rather than copying
+	class Reader {
+		private:
+			std::string_view data;
+			std::size_t pos = 0;
+
+		public:
+			explicit Reader(std::string_view data_): data(data_) { }
+
+			std::optional<Game> next();
+			std::size_t position() const { return pos; }
+	};
+
+	// The offset of the first game Reader would start at or after `offset`, or data.size().
+	// Reading from there gives the same games as reading the whole archive.
+	std::size_t nextGameStart(std::string_view data, std::size_t offset);
+
+	// the move tokens of one game, in order
+	class MoveTokens {
+		private:
+			std::string_view text;
+			std::size_t pos = 0;
+			Result result_ = Result::unknown;
+
+		public:
+			explicit MoveTokens(std::string_view gameText): text(gameText) { }
+
+			std::optional<std::string_view> next();
+			// from the [Result] tag or the result token, once next() has returned nullopt
+			Result result() const { return result_; }
+	};
+
+	struct Replay {
+		int plies = 0;                // moves played on the board
+		Notation::ParseError error;   // error.error is none if the whole game was played
+		std::string_view failedMove;  // the token error refers to
+		Result result = Result::unknown;
+
+		bool ok() const { return error.error == Notation::Error::none; }
+	};
+
+	// Plays `game` on `board`, which should hold the start position, checking every move
+	// with isMoveable(). onMove(board, move) is called before each move is made.
+	template <typename F> Replay replay(const Game &game, Board &board, F &&onMove) {
+		Replay r;
+		MoveTokens tokens{game.text};
+		while (const std::optional<std::string_view> token = tokens.next()) {
+			const std::optional<Move> m = Notation::parse(board, board.sideToMove(), *token, &r.error);
+			if (!m.has_value()) {
+				r.error.move = r.plies;
+				r.failedMove = *token;
+				return r;
+			}
+			if (!board.isMoveable(Board::vectorOf(m->from), Board::vectorOf(m->to))) {
+				r.error = Notation::ParseError{Notation::Error::notMoveable, r.plies, 0};
+				r.failedMove = *token;
+				return r;
+			}
+
+			onMove(static_cast<const Board &>(board), *m);
+			board.makeMove(*m);
+			++r.plies;
+		}
+		r.result = tokens.result();
+		return r;
+	}
+
+	inline Replay replay(const Game &game, Board &board) {
+		return replay(game, board, [](const Board &, Move) { });
+	}
+
+	struct ImportStats {
+		std::uint64_t games = 0, moves = 0, malformed = 0, bytes = 0;
+		double seconds = 0;
+
+		double gamesPerSecond() const { return seconds>0 ?games/seconds :0; }
+		double movesPerSecond() const { return seconds>0 ?moves/seconds :0; }
+	};
+
+	// Replays every game of the archive at `path`, logging and skipping malformed ones;
+	// nullopt if the file cannot be read.
+	std::optional<ImportStats> importArchive(const char *path, std::ostream &log);
+
+	struct Validation {
+		std::uint64_t offset;  // of the game within the archive
+		std::uint64_t key;     // Board::key() of the last position reached
+		int plies;             // moves played; if illegal, move plies+1 failed
+		Notation::Error error; // none if the whole game is legal
+
+		bool ok() const { return error == Notation::Error::none; }
+	};
+
+	struct ValidationReport {
+		std::vector<Validation> games; // in archive order, whatever the thread count
+		std::uint64_t moves = 0, bytes = 0;
+		int threads = 1;
+		double seconds = 0;
+
+		double gamesPerSecond() const { return seconds>0 ?games.size()/seconds :0; }
+		double movesPerSecond() const { return seconds>0 ?moves/seconds :0; }
+	};
+
+	// Replays every game of the archive at `path` on `threads` threads, each game on its
+	// own board; nullopt if the file cannot be read.
+	std::optional<ValidationReport> validateArchive(const char *path, int threads);
+}
+
+#endif
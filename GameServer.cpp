@@ -0,0 +1,300 @@
+#include "GameServer.hpp"
+#include "Notation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint32_t;
+using std::uint64_t;
+
+static_assert(sizeof(GameServer::Session) < 1024, "a session must stay under a kilobyte");
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// epoll data of the two descriptors that are not sessions
+	constexpr uint32_t LISTENER = 0xffffffff, SIGNALS = 0xfffffffe;
+
+	struct Address {
+		sockaddr_storage storage{};
+		socklen_t length = 0;
+		bool local = false; // a Unix socket
+
+		const sockaddr *get() const { return reinterpret_cast<const sockaddr *>(&storage); }
+	};
+
+	// a port number for TCP on 127.0.0.1, a path for a Unix socket otherwise
+	optional<Address> parseAddress(const string_view s) {
+		Address result;
+		if (!s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return '0'<=c && c<='9'; })) {
+			const long port = std::atol(string(s).c_str());
+			if (port<=0 || port>0xffff) return nullopt;
+			sockaddr_in &in = reinterpret_cast<sockaddr_in &>(result.storage);
+			in.sin_family = AF_INET;
+			in.sin_port = htons(port);
+			in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			result.length = sizeof in;
+		} else {
+			sockaddr_un &un = reinterpret_cast<sockaddr_un &>(result.storage);
+			if (s.empty() || s.size() >= sizeof un.sun_path) return nullopt;
+			un.sun_family = AF_UNIX;
+			std::memcpy(un.sun_path, s.data(), s.size());
+			result.length = sizeof un;
+			result.local = true;
+		}
+		return result;
+	}
+}
+
+GameServer::Fd &GameServer::Fd::operator =(Fd &&other) noexcept {
+	if (this != &other) {
+		if (fd >= 0) ::close(fd);
+		fd = std::exchange(other.fd, -1);
+	}
+	return *this;
+}
+
+GameServer::Fd::~Fd() {
+	if (fd >= 0) ::close(fd);
+}
+
+GameServer::~GameServer() {
+	for (Session &s: sessions) {
+		if (s.fd >= 0) ::close(s.fd);
+	}
+	if (!unixPath.empty() && listener.get() >= 0) unlink(unixPath.c_str());
+}
+
+optional<GameServer> GameServer::listen(const char *address, const size_t maxSessions, std::ostream &log) {
+	assert(0<maxSessions && maxSessions<SIGNALS);
+	const optional<Address> a = parseAddress(address);
+	if (!a.has_value()) {
+		log <<"not a port or socket path: " <<address <<'\n';
+		return nullopt;
+	}
+
+	GameServer server;
+	server.listener = Fd{socket(a->storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+	if (a->local) {
+		unlink(address);
+	} else {
+		const int on = 1;
+		setsockopt(server.listener.get(), SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+	}
+	if (server.listener.get()<0 || bind(server.listener.get(), a->get(), a->length)!=0 || ::listen(server.listener.get(), SOMAXCONN)!=0) {
+		log <<"cannot listen on " <<address <<": " <<std::strerror(errno) <<'\n';
+		return nullopt;
+	}
+	if (a->local) server.unixPath = address;
+
+	// SIGINT and SIGTERM end run() through the loop rather than interrupting it
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, nullptr);
+	server.signals = Fd{signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)};
+
+	server.epoll = Fd{epoll_create1(EPOLL_CLOEXEC)};
+	epoll_event listenEvent{}, signalEvent{};
+	listenEvent.events = signalEvent.events = EPOLLIN;
+	listenEvent.data.u32 = LISTENER;
+	signalEvent.data.u32 = SIGNALS;
+	if (server.epoll.get()<0 || server.signals.get()<0
+			|| epoll_ctl(server.epoll.get(), EPOLL_CTL_ADD, server.listener.get(), &listenEvent)!=0
+			|| epoll_ctl(server.epoll.get(), EPOLL_CTL_ADD, server.signals.get(), &signalEvent)!=0) {
+		log <<"cannot set up epoll: " <<std::strerror(errno) <<'\n';
+		return nullopt;
+	}
+
+	server.sessions.resize(maxSessions);
+	server.freeSessions.reserve(maxSessions);
+	// the lowest index is handed out first
+	for (size_t i=maxSessions; i-->0; ) server.freeSessions.push_back(i);
+	server.latency.assign(N_BUCKET, 0);
+	server.replies.reserve(4096);
+	return server;
+}
+
+int GameServer::connect(const char *address) {
+	const optional<Address> a = parseAddress(address);
+	if (!a.has_value()) return -1;
+	const int fd = socket(a->storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (::connect(fd, a->get(), a->length) != 0) {
+		::close(fd);
+		return -1;
+	}
+	if (!a->local) {
+		const int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+	}
+	return fd;
+}
+
+void GameServer::accept() {
+	while (true) {
+		const int fd = accept4(listener.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) return;
+		if (freeSessions.empty()) {
+			::close(fd);
+			continue;
+		}
+
+		const int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+		const uint32_t index = freeSessions.back();
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u32 = index;
+		if (epoll_ctl(epoll.get(), EPOLL_CTL_ADD, fd, &event) != 0) {
+			::close(fd);
+			continue;
+		}
+		freeSessions.pop_back();
+		sessions[index].fd = fd;
+		peakSessions = std::max(peakSessions, activeSessions());
+	}
+}
+
+void GameServer::close(const uint32_t index) {
+	Session &s = sessions[index];
+	epoll_ctl(epoll.get(), EPOLL_CTL_DEL, s.fd, nullptr);
+	::close(s.fd);
+	s = Session{};
+	freeSessions.push_back(index);
+}
+
+void GameServer::answer(Session &session, const string_view request, string &out) {
+	if (request == "new") {
+		session.board = Board::makeStandardBoard();
+		out += "ok\n";
+	} else if (request == "fen") {
+		char fen[Board::MAX_FEN_SIZE];
+		out += "fen ";
+		out.append(fen, session.board.writeFen(fen));
+		out += '\n';
+	} else if (request == "stats") {
+		out += "stats " + stats() + '\n';
+	} else {
+		// as the REPL: a move of the side to move that Board::isMoveable() accepts
+		const Clock::time_point begin = Clock::now();
+		const Board &board = session.board;
+		Notation::ParseError error;
+		optional<Move> m = Notation::parse(board, board.sideToMove(), request, &error);
+		if (m.has_value() && !board.isMoveable(Board::vectorOf(m->from), Board::vectorOf(m->to))) {
+			error.error = Notation::Error::notMoveable;
+			m = nullopt;
+		}
+		if (m.has_value()) session.board.makeMove(*m);
+		const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+
+		++moves;
+		maxNs = std::max(maxNs, ns);
+		++latency[std::min<uint64_t>(ns / BUCKET_NS, N_BUCKET - 1)];
+		if (m.has_value()) {
+			out += "ok\n";
+		} else {
+			++rejected;
+			out += "error ";
+			out += Notation::errorName(error.error);
+			out += '\n';
+		}
+	}
+}
+
+void GameServer::receive(const uint32_t index) {
+	Session &s = sessions[index];
+	char input[4096];
+	const ssize_t n = read(s.fd, input, sizeof input);
+	if (n < 0 && (errno==EAGAIN || errno==EINTR)) return;
+	if (n <= 0) {
+		close(index);
+		return;
+	}
+
+	string &out = replies;
+	out.clear();
+	for (ssize_t i=0; i<n; ++i) {
+		const char c = input[i];
+		if (c == '\n') {
+			string_view request{s.line.data(), s.length};
+			if (!request.empty() && request.back() == '\r') request.remove_suffix(1);
+			if (s.overlong) out += "error " + string(Notation::errorName(Notation::Error::syntax)) + '\n';
+			else answer(s, request, out);
+			s.length = 0;
+			s.overlong = false;
+		} else if (s.length < MAX_LINE) {
+			s.line[s.length++] = c;
+		} else {
+			s.overlong = true;
+		}
+	}
+
+	if (!out.empty() && send(s.fd, out.data(), out.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(out.size())) close(index);
+}
+
+void GameServer::run(std::ostream &log) {
+	epoll_event events[256];
+	while (true) {
+		const int n = epoll_wait(epoll.get(), events, std::size(events), -1);
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) {
+			log <<"epoll_wait: " <<std::strerror(errno) <<'\n';
+			return;
+		}
+
+		for (int i=0; i<n; ++i) {
+			const uint32_t index = events[i].data.u32;
+			if (index == LISTENER) {
+				accept();
+			} else if (index == SIGNALS) {
+				log <<stats() <<'\n';
+				return;
+			} else if (sessions[index].fd >= 0) {
+				receive(index);
+			}
+		}
+	}
+}
+
+double GameServer::percentileNs(const double p) const {
+	if (moves == 0) return 0;
+	const uint64_t rank = std::max<uint64_t>(1, p * moves + 0.5);
+	uint64_t seen = 0;
+	for (int b=0; b<N_BUCKET; ++b) {
+		seen += latency[b];
+		if (seen >= rank) return b==N_BUCKET-1 ?maxNs :(b + 1) * BUCKET_NS;
+	}
+	return maxNs;
+}
+
+string GameServer::stats() const {
+	std::ostringstream s;
+	s <<"sessions " <<activeSessions() <<" peak " <<peakSessions <<" moves " <<moves <<" rejected " <<rejected
+		<<" p50 " <<percentileNs(0.5)/1000 <<" us p99 " <<percentileNs(0.99)/1000 <<" us max " <<maxNs/1000.0
+		<<" us session " <<sizeof(Session) <<" bytes";
+	return s.str();
+}
@@ -0,0 +1,94 @@
+#ifndef GAME_SERVER_HPP
+#define GAME_SERVER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Board.hpp"
+
+// Many games at once on one thread: an epoll loop over a listening socket, either TCP on
+// 127.0.0.1 when the address is a port number or a Unix socket at the address otherwise.
+// Every connection is a game from the standard position, with a Board from a pool sized
+// up front, and both sides move on it in turn. A line is one request, answered by one line:
+//
+//   <move>   a move of the side to move in the REPL's notation, e.g. p2p5: "ok", or
+//            "error <reason>" as Notation::errorName() if parsing or Board::isMoveable() fails
+//   new      back to the standard position: "ok"
+//   fen      "fen <the position>"
+//   stats    "stats " and the line of stats()
+//
+// A client that sends more than it reads gets disconnected rather than buffered for.
+class GameServer {
+	public:
+		// longest request line kept; a longer one is answered as a syntax error
+		static constexpr std::size_t MAX_LINE = 15;
+
+		struct Session {
+			Board board{Board::makeStandardBoard()};
+			int fd = -1;
+			std::uint8_t length = 0; // of the incomplete line in `line`
+			bool overlong = false;   // dropping the rest of a line beyond MAX_LINE
+			std::array<char, MAX_LINE> line;
+		};
+
+	private:
+		// a file descriptor closed with its owner
+		class Fd {
+			private:
+				int fd = -1;
+
+			public:
+				Fd() = default;
+				explicit Fd(int fd_): fd(fd_) { }
+				Fd(Fd &&other) noexcept: fd(std::exchange(other.fd, -1)) { }
+				Fd &operator =(Fd &&other) noexcept;
+				~Fd();
+
+				int get() const { return fd; }
+		};
+
+		// validation time of a move in buckets of BUCKET_NS, the last one for anything longer
+		static constexpr int N_BUCKET = 4096;
+		static constexpr int BUCKET_NS = 100;
+
+		Fd listener, epoll, signals;
+		std::string unixPath; // removed again by the destructor, if listening on one
+		std::vector<Session> sessions;
+		std::vector<std::uint32_t> freeSessions;
+		std::size_t peakSessions = 0;
+		std::uint64_t moves = 0, rejected = 0, maxNs = 0;
+		std::vector<std::uint64_t> latency;
+		std::string replies; // to the requests of one read, kept for its capacity
+
+		GameServer() = default;
+		void accept();
+		void close(std::uint32_t index);
+		void receive(std::uint32_t index);
+		// the answer to `request`, appended to `out`
+		void answer(Session &session, std::string_view request, std::string &out);
+		double percentileNs(double p) const;
+
+	public:
+		GameServer(GameServer &&) = default;
+		GameServer &operator =(GameServer &&) = default;
+		~GameServer();
+
+		// a server of at most maxSessions games listening on `address`, which runs() until
+		// SIGINT or SIGTERM; nullopt with the reason on `log` if it cannot listen
+		static std::optional<GameServer> listen(const char *address, std::size_t maxSessions, std::ostream &log);
+		// the socket a client of `address` talks over, blocking; -1 if it cannot connect
+		static int connect(const char *address);
+
+		void run(std::ostream &log);
+		std::size_t activeSessions() const { return sessions.size() - freeSessions.size(); }
+		// sessions, moves and validation latency percentiles so far, on one line
+		std::string stats() const;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "History.hpp"
+#include "Evaluator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+using PieceNS::Kind;
+using std::optional;
+using std::nullopt;
+
+optional<Team> History::Cycle::loser() const {
+	for (const Perpetual p: {Perpetual::check, Perpetual::chase}) {
+		const bool red = of(Team::red) == p, black = of(Team::black) == p;
+		if (red != black) return red ?Team::red :Team::black;
+		if (red) return nullopt;
+	}
+	return nullopt;
+}
+
+void History::reset(const Board &start) {
+	entries[0] = {start.key(), {NO_MOVE, Board::NO_PIECE, 0, 0, 0}, static_cast<std::uint16_t>(start.halfmoveClock())};
+	n = 1;
+}
+
+int History::repetitions() const {
+	const Entry &now = back(0);
+	const int limit = lookBack();
+	int result = 0;
+	for (int d=4; d<=limit; d+=2) result += back(d).key == now.key;
+	return result;
+}
+
+bool History::isChase(Board &after, const Move m) {
+	const Team mover = PieceNS::teamOf(after.idAt(Board::vectorOf(m.to)));
+	const Team victim = otherTeam(mover);
+	const Kind attacker = PieceNS::kindOf(after.idAt(Board::vectorOf(m.to)));
+	// the Jiang and the Zu may attack a piece as often as they like
+	if (attacker==Kind::jiang || attacker==Kind::zu) return false;
+	const int attackerValue = Evaluator::materialValue[static_cast<int>(attacker)];
+
+	for (Bitboard targets=after.targetsOf(m.to) & after.piecesOf(victim); targets; ) {
+		const int square = BitboardNS::popLowest(targets);
+		const Board::PieceId id = after.idAt(Board::vectorOf(square));
+		const Kind kind = PieceNS::kindOf(id);
+		if (kind == Kind::jiang) continue;
+		if (kind==Kind::zu && Board::inTeam(victim, Board::vectorOf(square))) continue;
+
+		// a capture that would leave the own Jiang in check is no threat
+		const Move capture{m.to, static_cast<std::uint8_t>(square)};
+		if (!after.isLegal(capture)) continue;
+		if (Evaluator::materialValue[static_cast<int>(kind)] > attackerValue) return true;
+
+		const Undo undo = after.makeMove(capture);
+		bool defended = false;
+		for (Bitboard defenders=after.piecesOf(victim); defenders && !defended; ) {
+			const int from = BitboardNS::popLowest(defenders);
+			defended = BitboardNS::test(after.targetsOf(from), square) && after.isLegal(Move{static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(square)});
+		}
+		after.unmakeMove(undo);
+		if (!defended) return true;
+	}
+	return false;
+}
+
+History::Cycle History::classify(const Board &current, const int plies) const {
+	assert(0<plies && plies<n && plies<=LOOK_BACK);
+
+	// walked backwards: each position is judged for the move that led to it, then taken back
+	std::array<bool, 2> checks{true, true}, chases{true, true}, chased{false, false};
+	Board board{current};
+	for (int k=0; k<plies; ++k) {
+		const Undo &undo = back(k).undo;
+		const Team mover = otherTeam(board.sideToMove());
+		const int t = static_cast<int>(mover);
+		const bool check = board.isInCheck(board.sideToMove());
+		const bool chase = !check && isChase(board, undo.move);
+		checks[t] = checks[t] && check;
+		chases[t] = chases[t] && (check || chase);
+		chased[t] = chased[t] || chase;
+		board.unmakeMove(undo);
+	}
+
+	Cycle result;
+	result.plies = plies;
+	for (int t=0; t<2; ++t) {
+		result.by[t] = checks[t] ?Perpetual::check :chases[t] && chased[t] ?Perpetual::chase :Perpetual::none;
+	}
+	return result;
+}
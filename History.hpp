@@ -0,0 +1,97 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+
+#include "Board.hpp"
+#include "Move.hpp"
+#include "Team.hpp"
+
+// The positions of a game or of a search line, newest last, each with the Undo of the
+// move that led to it. Kept next to a Board and pushed/popped with its makeMove()/
+// unmakeMove(); fixed capacity, the oldest positions are overwritten once it is full.
+//
+// A position can only recur after the last capture, so lastRepeat() looks back at most
+// Board::halfmoveClock() plies, every second one. Without a move-count draw the clock has
+// no bound, so the look-back also stops at LOOK_BACK: older entries may have been
+// overwritten by a search line pushed on top of the game and popped again.
+class History {
+	public:
+		// a power of two
+		static constexpr int CAPACITY = 256;
+		// plies a search line may push on top of a game, Search::MAX_PLY at most
+		static constexpr int MAX_LINE = 64;
+		// plies back that are still those pushed last, however deep a line went since
+		static constexpr int LOOK_BACK = CAPACITY - MAX_LINE - 1;
+
+		// what one side did with every one of its moves of a cycle
+		enum class Perpetual : std::uint8_t { none, chase, check };
+
+		struct Cycle {
+			int plies = 0;
+			std::array<Perpetual, 2> by{Perpetual::none, Perpetual::none};
+
+			Perpetual of(Team team) const { return by[static_cast<int>(team)]; }
+			// Perpetual check loses, then perpetual chase, when only one side commits it;
+			// nullopt when the repetition is a draw.
+			std::optional<Team> loser() const;
+		};
+
+	private:
+		struct Entry {
+			std::uint64_t key;
+			Undo undo;             // the move into this position, unused for the first one
+			std::uint16_t halfmoves; // Board::halfmoveClock() of this position
+		};
+
+		std::array<Entry, CAPACITY> entries;
+		// positions pushed since reset(), of which the last min(n, CAPACITY) are kept
+		int n = 0;
+
+		const Entry &back(int plies) const { return entries[(n - 1 - plies) & (CAPACITY - 1)]; }
+		// the plies back where the current position may have occurred before
+		int lookBack() const { return std::min({static_cast<int>(back(0).halfmoves), n - 1, LOOK_BACK}); }
+
+	public:
+		History() = default;
+		explicit History(const Board &start) { reset(start); }
+
+		void reset(const Board &start);
+		// `after` is the board once `undo`'s move was made
+		void push(const Board &after, const Undo &undo) {
+			entries[n & (CAPACITY - 1)] = {after.key(), undo, static_cast<std::uint16_t>(after.halfmoveClock())};
+			++n;
+		}
+		void pop() { assert(n > 1); --n; }
+
+		int size() const { return n; }
+		std::uint64_t key() const { return back(0).key; }
+		Move lastMove(int plies = 0) const { return back(plies).undo.move; }
+
+		// plies back to the latest earlier occurrence of the current position, 0 if none
+		int lastRepeat() const {
+			const Entry &now = back(0);
+			const int limit = lookBack();
+			for (int d=4; d<=limit; d+=2) {
+				if (back(d).key == now.key) return d;
+			}
+			return 0;
+		}
+		// earlier occurrences of the current position
+		int repetitions() const;
+
+		// what each side did over the last `plies` moves, which `current` is the result of;
+		// plies must not exceed LOOK_BACK nor the plies pushed
+		Cycle classify(const Board &current, int plies) const;
+		// whether `m`, just made on `after`, chases: the moved piece, other than a Jiang or a
+		// Zu, attacks an enemy piece other than the Jiang or a Zu still on its own side, which
+		// is either undefended or worth more than the attacker; the captures it tries are
+		// made on `after` and taken back
+		static bool isChase(Board &after, Move m);
+};
+
+#endif
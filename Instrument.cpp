@@ -0,0 +1,108 @@
+#include "Instrument.hpp"
+
+#ifdef CCHESS_INSTRUMENT
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+namespace Instrument {
+	namespace {
+		std::atomic<Block *> blocks{nullptr};
+
+		const char *const clockName =
+	#if defined(__x86_64__) || defined(__i386__)
+			"rdtsc";
+	#else
+			"steady_clock_ns";
+	#endif
+
+		string nameOf(const int probe) {
+			static const char *const kindNames[PieceNS::N_KIND]{"Jiang", "Shi", "Xiang", "Ma", "Ju", "Pao", "Zu"};
+			if (probe == isMoveable) return "Board::isMoveable";
+			if (probe == countPiecesBetween) return "Board::countPiecesBetween";
+			if (probe < getPiecesOfCol) return "MoveKernel::isMoveCandidate(" + string(kindNames[probe - isMoveCandidate]) + ")";
+			if (probe == getPiecesOfCol) return "Board::getPiecesOfCol";
+			if (probe == print) return "Board::print";
+			if (probe == targetsOf) return "Board::targetsOf";
+			if (probe == generatePseudoLegalMoves) return "Board::generatePseudoLegalMoves";
+			if (probe == isInCheck) return "Board::isInCheck";
+			return "Notation::parse";
+		}
+
+		struct Totals {
+			uint64_t calls = 0, ticks = 0;
+		};
+
+		// dumps the counters when the program ends
+		struct AtExit {
+			~AtExit() {
+				const char *path = std::getenv("CCHESS_INSTRUMENT_OUT");
+				if (!path || !*path) {
+					dump(std::cerr, Format::json);
+					return;
+				}
+				const size_t n = std::strlen(path);
+				std::ofstream out{path, std::ios::trunc};
+				dump(out, n>=4 && !std::strcmp(path + n - 4, ".csv") ?Format::csv :Format::json);
+			}
+		} atExit;
+	}
+
+	Block *registerBlock() {
+		Block *const block = new Block;
+		block->next = blocks.load(std::memory_order_relaxed);
+		while (!blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) { }
+		return block;
+	}
+
+	void dump(std::ostream &out, const Format format) {
+		// threads in the order they first counted
+		vector<const Block *> threads;
+		for (const Block *b=blocks.load(std::memory_order_acquire); b; b=b->next) threads.insert(threads.begin(), b);
+
+		std::array<Totals, N_PROBE> totals{};
+		vector<std::array<Totals, N_PROBE>> perThread(threads.size());
+		for (size_t t=0; t<threads.size(); ++t) {
+			for (int p=0; p<N_PROBE; ++p) {
+				perThread[t][p] = {threads[t]->counters[p].calls.load(std::memory_order_relaxed), threads[t]->counters[p].ticks.load(std::memory_order_relaxed)};
+				totals[p].calls += perThread[t][p].calls;
+				totals[p].ticks += perThread[t][p].ticks;
+			}
+		}
+
+		if (format == Format::csv) {
+			out <<"probe,thread,calls," <<clockName <<'\n';
+			for (int p=0; p<N_PROBE; ++p) {
+				out <<nameOf(p) <<",all," <<totals[p].calls <<',' <<totals[p].ticks <<'\n';
+				for (size_t t=0; t<threads.size(); ++t) {
+					if (perThread[t][p].calls) out <<nameOf(p) <<',' <<t <<',' <<perThread[t][p].calls <<',' <<perThread[t][p].ticks <<'\n';
+				}
+			}
+			out.flush();
+			return;
+		}
+
+		out <<"{\"clock\": \"" <<clockName <<"\", \"threads\": " <<threads.size() <<", \"probes\": [";
+		for (int p=0; p<N_PROBE; ++p) {
+			out <<(p ?",\n" :"\n") <<"  {\"name\": \"" <<nameOf(p) <<"\", \"calls\": " <<totals[p].calls <<", \"ticks\": " <<totals[p].ticks
+				<<", \"ticksPerCall\": " <<(totals[p].calls ?static_cast<double>(totals[p].ticks)/totals[p].calls :0) <<", \"perThread\": [";
+			for (size_t t=0; t<threads.size(); ++t) {
+				out <<(t ?", " :"") <<"{\"calls\": " <<perThread[t][p].calls <<", \"ticks\": " <<perThread[t][p].ticks <<'}';
+			}
+			out <<"]}";
+		}
+		out <<"\n]}" <<std::endl;
+	}
+}
+
+#endif
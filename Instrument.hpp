@@ -0,0 +1,96 @@
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "Piece.hpp"
+
+#ifdef CCHESS_INSTRUMENT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+// Call counts and time spent in the rule hot paths, built in with -DCCHESS_INSTRUMENT=ON.
+// A function opens a scope with CCHESS_PROBE(Instrument::<probe>); otherwise the macro
+// is an empty statement and none of the code below is compiled.
+//
+// Every thread counts into a block of its own, linked into a global list on its first
+// probe and never freed, so counting takes no lock and no shared cache line. At exit the
+// blocks are summed and dumped to the file named by $CCHESS_INSTRUMENT_OUT, as CSV if it
+// ends in .csv and as JSON otherwise, or as JSON to stderr if it is unset. Time is in
+// rdtsc cycles on x86, in steady_clock nanoseconds elsewhere, and includes nested probes.
+namespace Instrument {
+	enum Probe : int {
+		isMoveable,
+		countPiecesBetween,
+		// one per PieceNS::Kind, for MoveKernel::isMoveCandidate() by the kind that moves
+		isMoveCandidate,
+		getPiecesOfCol = isMoveCandidate + PieceNS::N_KIND,
+		print,
+		targetsOf,
+		generatePseudoLegalMoves,
+		isInCheck,
+		notationParse,
+		N_PROBE
+	};
+
+	enum class Format { json, csv };
+
+#ifdef CCHESS_INSTRUMENT
+	struct Counter {
+		// written by the owning thread only, read by dump()
+		std::atomic<std::uint64_t> calls{0}, ticks{0};
+
+		void add(std::uint64_t t) {
+			calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			ticks.store(ticks.load(std::memory_order_relaxed) + t, std::memory_order_relaxed);
+		}
+	};
+
+	struct Block {
+		Counter counters[N_PROBE];
+		Block *next = nullptr;
+	};
+
+	// a new block, pushed onto the list dump() reads
+	Block *registerBlock();
+	inline Block &local() {
+		thread_local Block *const block = registerBlock();
+		return *block;
+	}
+
+	inline std::uint64_t ticks() {
+	#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+	#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	#endif
+	}
+
+	class Scope {
+		private:
+			Counter &counter;
+			const std::uint64_t start;
+
+		public:
+			explicit Scope(Probe probe): counter(local().counters[probe]), start(ticks()) { }
+			~Scope() { counter.add(ticks() - start); }
+			Scope(const Scope &) = delete;
+			Scope &operator =(const Scope &) = delete;
+	};
+
+	// the counters so far of every thread, and their sum
+	void dump(std::ostream &out, Format format);
+
+	#define CCHESS_PROBE(probe) const Instrument::Scope instrumentScope_{probe}
+#else
+	#define CCHESS_PROBE(probe) static_cast<void>(0)
+#endif
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::nullopt;
+using std::optional;
+using std::size_t;
+
+optional<MappedFile> MappedFile::open(const char *path) {
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return nullopt;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return nullopt;
+	}
+
+	const size_t size = st.st_size;
+	if (size == 0) {
+		close(fd);
+		return MappedFile{nullptr, 0};
+	}
+
+	void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return nullopt;
+
+	madvise(p, size, MADV_SEQUENTIAL);
+	return MappedFile{static_cast<const char *>(p), size};
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+	: data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) { }
+
+MappedFile &MappedFile::operator =(MappedFile &&other) noexcept {
+	std::swap(data_, other.data_);
+	std::swap(size_, other.size_);
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	if (data_) munmap(const_cast<char *>(data_), size_);
+}
+
+void MappedFile::release(const size_t offset) const {
+	const size_t page = sysconf(_SC_PAGESIZE);
+	const size_t end = std::min(offset, size_) / page * page;
+	if (end > 0) madvise(const_cast<char *>(data_), end, MADV_DONTNEED);
+}
+
+void MappedFile::adviseRandom() const {
+	if (data_) madvise(const_cast<char *>(data_), size_, MADV_RANDOM);
+}
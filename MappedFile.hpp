@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+// A read-only memory mapping of a whole file; pages are read in by the kernel on first
+// touch, so mapping a file of any size costs no memory up front.
+class MappedFile {
+	private:
+		const char *data_ = nullptr;
+		std::size_t size_ = 0;
+
+		MappedFile(const char *data, std::size_t size): data_(data), size_(size) { }
+
+	public:
+		static std::optional<MappedFile> open(const char *path);
+
+		MappedFile(MappedFile &&other) noexcept;
+		MappedFile &operator =(MappedFile &&other) noexcept;
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator =(const MappedFile &) = delete;
+		~MappedFile();
+
+		const char *data() const { return data_; }
+		std::size_t size() const { return size_; }
+		std::string_view view() const { return {data_, size_}; }
+
+		// tells the kernel the pages before `offset` will not be read again, so that
+		// streaming through a large file keeps a flat resident size
+		void release(std::size_t offset) const;
+		// for files read in no particular order, such as lookup tables; turns off read-ahead
+		void adviseRandom() const;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef MOVE_HPP
+#define MOVE_HPP
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+// from and to are square indices as in Board::indexOf()
+struct Move {
+	std::uint8_t from, to;
+
+	bool operator ==(Move other) const { return from==other.from && to==other.to; }
+	bool operator !=(Move other) const { return !(*this == other); }
+};
+
+// never a real move, for "no move known"
+inline constexpr Move NO_MOVE{0, 0};
+
+// what Board::unmakeMove() needs to take a move back; captured is a Board::PieceId
+struct Undo {
+	Move move;
+	std::uint8_t captured;
+	std::uint16_t halfmoveClock; // before the move
+	std::int16_t scoreDelta;
+	std::uint64_t keyDelta;
+};
+
+// fixed capacity so that generating moves never touches the heap;
+// no xiangqi position has more than 128 pseudo-legal moves for one side
+class MoveList {
+	public:
+		static constexpr int CAPACITY = 128;
+
+	private:
+		std::array<Move, CAPACITY> moves;
+		int n = 0;
+
+	public:
+		void push(Move m) { assert(n < CAPACITY); moves[n++] = m; }
+		void clear() { n = 0; }
+		int size() const { return n; }
+		bool empty() const { return n == 0; }
+
+		Move &operator [](int i) { assert(0<=i && i<n); return moves[i]; }
+		Move operator [](int i) const { assert(0<=i && i<n); return moves[i]; }
+		Move *begin() { return moves.data(); }
+		Move *end() { return moves.data() + n; }
+		const Move *begin() const { return moves.data(); }
+		const Move *end() const { return moves.data() + n; }
+};
+
+#endif
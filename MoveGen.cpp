@@ -0,0 +1,168 @@
+#include "Board.hpp"
+#include "Instrument.hpp"
+#include "Move.hpp"
+#include "Piece.hpp"
+
+using PieceNS::Kind;
+
+Bitboard Board::lineAttackers(const int index, const Bitboard sliders, const Bitboard cannons, const std::uint16_t rank, const std::uint16_t file) {
+	using namespace BitboardNS;
+	const int x = index/N_COL, y = index%N_COL;
+	const LineAttacks &r = rankAttacks(y, rank);
+	const LineAttacks &f = fileAttacks(x, file);
+	return ((rankToBitboard(x, r.firstBlocker) | fileToBitboard(y, f.firstBlocker)) & sliders)
+		| ((rankToBitboard(x, r.secondBlocker) | fileToBitboard(y, f.secondBlocker)) & cannons);
+}
+
+Bitboard Board::maSources(const int index, const Bitboard occupied) {
+	using BitboardNS::tables;
+	Bitboard result = 0;
+	for (int j=0; j<4; ++j) {
+		const std::uint8_t leg = tables.maAttackLeg[index][j];
+		if (leg!=NO_SQUARE && !BitboardNS::test(occupied, leg)) result |= tables.maAttackersByLeg[index][j];
+	}
+	return result;
+}
+
+bool Board::isJiangAttacked(const int jiang, const Team enemy, const Bitboard enemies, const Bitboard occupied, const std::uint16_t file) const {
+	// the enemy Jiang checks like a Ju along the file; Shi and Xiang never leave their own
+	// half, so they cannot attack a Jiang
+	const auto of = [&](const Kind kind) { return kindBits[static_cast<int>(kind)] & enemies; };
+	return lineAttackers(jiang, of(Kind::ju) | of(Kind::jiang), of(Kind::pao), rankBits(occupied, jiang/N_COL), file)
+		|| (maSources(jiang, occupied) & of(Kind::ma))
+		|| (BitboardNS::tables.zuAttackers[static_cast<int>(enemy)][jiang] & of(Kind::zu));
+}
+
+bool Board::isInCheck(const Team team) const {
+	CCHESS_PROBE(Instrument::isInCheck);
+	const std::uint8_t jiang = jiangSquare(team);
+	if (jiang == NO_SQUARE) return false;
+
+	const Team enemy = otherTeam(team);
+	return isJiangAttacked(jiang, enemy, piecesOf(enemy), occupancy(), fileBits[jiang%N_COL]);
+}
+
+Bitboard Board::attackersOf(const int index, const Team team) const {
+	using BitboardNS::tables;
+	assert(0<=index && index<N_SQUARE);
+
+	const int t = static_cast<int>(team);
+	Bitboard result = lineAttackers(index, piecesOf(Kind::ju, team), piecesOf(Kind::pao, team))
+		| (maSources(index) & piecesOf(Kind::ma, team))
+		| (tables.zuAttackers[t][index] & piecesOf(Kind::zu, team));
+	if (BitboardNS::test(tables.palace[t], index)) {
+		result |= (tables.jiangSteps[t][index] & piecesOf(Kind::jiang, team)) | (tables.shiSteps[t][index] & piecesOf(Kind::shi, team));
+	}
+	if (BitboardNS::test(tables.half[t], index)) {
+		const Bitboard xiang = piecesOf(Kind::xiang, team);
+		for (int j=0; j<4; ++j) {
+			const std::uint8_t eye = tables.xiangEye[index][j];
+			if (eye!=NO_SQUARE && squares[eye]==NO_PIECE) result |= xiang & BitboardNS::bit(tables.xiangByEye[index][j]);
+		}
+	}
+	return result;
+}
+
+Bitboard Board::pinnedPieces(const Team team) const {
+	using namespace BitboardNS;
+	const std::uint8_t jiang = jiangSquare(team);
+	if (jiang == NO_SQUARE) return 0;
+
+	const Team enemy = otherTeam(team);
+	const Bitboard sliders = piecesOf(Kind::ju, enemy) | piecesOf(Kind::jiang, enemy);
+	const Bitboard cannons = piecesOf(Kind::pao, enemy);
+	Bitboard result = 0;
+
+	// the first three pieces each way along the rank and file: a Ju or Jiang second, or a
+	// Pao third, is held back by those in front of it
+	const auto alongLine = [&](const auto &attacks, const auto &toBitboard, const int pos, const std::uint16_t occupancy) {
+		const std::uint16_t below = (1u << pos) - 1;
+		for (const std::uint16_t side: {below, static_cast<std::uint16_t>(~below & ~(1u << pos))}) {
+			const LineAttacks &a = attacks(pos, occupancy);
+			const std::uint16_t first = a.firstBlocker & side;
+			const Bitboard b1 = toBitboard(first);
+			const Bitboard b2 = toBitboard(a.secondBlocker & side);
+			const Bitboard b3 = toBitboard(attacks(pos, occupancy & ~first).secondBlocker & side);
+			if (b2 & sliders) result |= b1;
+			if (b3 & cannons) result |= b1 | b2;
+		}
+	};
+	const int x = jiang/N_COL, y = jiang%N_COL;
+	alongLine(rankAttacks, [x](std::uint16_t m){ return rankToBitboard(x, m); }, y, rankBits(x));
+	alongLine(fileAttacks, [y](std::uint16_t m){ return fileToBitboard(y, m); }, x, fileBits[y]);
+
+	const Bitboard ma = piecesOf(Kind::ma, enemy);
+	for (int j=0; j<4; ++j) {
+		const std::uint8_t leg = tables.maAttackLeg[jiang][j];
+		if (leg!=NO_SQUARE && (tables.maAttackersByLeg[jiang][j] & ma)) result |= bit(leg);
+	}
+
+	return result & piecesOf(team);
+}
+
+MoveList Board::generatePseudoLegalMoves(const Team team) const {
+	CCHESS_PROBE(Instrument::generatePseudoLegalMoves);
+	MoveList moves;
+	for (int s=0; s<PieceNS::N_SLOT_TEAM; ++s) {
+		const std::uint8_t from = squareOfSlot(team, s);
+		if (from == NO_SQUARE) continue;
+
+		for (Bitboard targets=targetsOf(from); targets; ) {
+			moves.push({from, static_cast<std::uint8_t>(BitboardNS::popLowest(targets))});
+		}
+	}
+
+	return moves;
+}
+
+MoveList Board::generatePseudoLegalCaptures(const Team team) const {
+	const Bitboard enemies = piecesOf(otherTeam(team));
+	MoveList moves;
+	for (int s=0; s<PieceNS::N_SLOT_TEAM; ++s) {
+		const std::uint8_t from = squareOfSlot(team, s);
+		if (from == NO_SQUARE) continue;
+
+		for (Bitboard targets=targetsOf(from) & enemies; targets; ) {
+			moves.push({from, static_cast<std::uint8_t>(BitboardNS::popLowest(targets))});
+		}
+	}
+
+	return moves;
+}
+
+bool Board::isLegal(const Move m) const {
+	using BitboardNS::bit;
+	assert(squares[m.from] != NO_PIECE);
+
+	// the bitboards isInCheck() reads, as makeMove() would leave them
+	const PieceId id = squares[m.from];
+	const Team team = PieceNS::teamOf(id);
+	const std::uint8_t jiang = PieceNS::kindOf(id)==Kind::jiang ?m.to :jiangSquare(team);
+	if (jiang == NO_SQUARE) return true;
+	const Team enemy = otherTeam(team);
+	const Bitboard occupied = (occupancy() & ~bit(m.from)) | bit(m.to);
+	const int y = jiang%N_COL;
+	std::uint16_t file = fileBits[y];
+	if (m.from%N_COL == y) file &= ~(1u << m.from/N_COL);
+	if (m.to%N_COL == y) file |= 1u << m.to/N_COL;
+	return !isJiangAttacked(jiang, enemy, piecesOf(enemy) & ~bit(m.to), occupied, file);
+}
+
+MoveList Board::generateMoves(const Team team) const {
+	const std::uint8_t jiang = jiangSquare(team);
+	if (jiang == NO_SQUARE) return generatePseudoLegalMoves(team);
+
+	// Out of check, only a move of the Jiang or of a pinned piece, or one onto the Jiang's
+	// rank or file where it may become the screen of a Pao, can leave the Jiang attacked.
+	const bool inCheck = isInCheck(team);
+	const Bitboard risky = pinnedPieces(team) | BitboardNS::bit(jiang);
+	const Bitboard lines = BitboardNS::rankToBitboard(jiang/N_COL, (1u << N_COL) - 1) | BitboardNS::fileToBitboard(jiang%N_COL, (1u << N_ROW) - 1);
+
+	MoveList moves;
+	for (Move m: generatePseudoLegalMoves(team)) {
+		const bool safe = !inCheck && !BitboardNS::test(risky, m.from) && !BitboardNS::test(lines, m.to);
+		if (safe || isLegal(m)) moves.push(m);
+	}
+
+	return moves;
+}
@@ -0,0 +1,170 @@
+#ifndef MOVE_KERNEL_HPP
+#define MOVE_KERNEL_HPP
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+#include "Bitboard.hpp"
+#include "Board.hpp"
+#include "Instrument.hpp"
+#include "Piece.hpp"
+#include "Square.hpp"
+#include "Team.hpp"
+#include "Vector2d.hpp"
+
+// The rules of PieceNS::Base and its subclasses as constexpr tables and kernels templated
+// on kind and team, on square indices as in Board::indexOf(). isMoveCandidate() and
+// destOfDirection() at the bottom pick the kernel by a switch, for callers that know kind
+// and team only at run time; the classes of Piece.hpp forward here.
+namespace MoveKernel {
+	using PieceNS::Kind;
+	using BitboardNS::N_COL;
+	using BitboardNS::N_ROW;
+	using BitboardNS::N_SQUARE;
+	using BitboardNS::NO_SQUARE;
+
+	struct Offset { int dx, dy; };
+
+	constexpr int abs(int v) { return v<0 ?-v :v; }
+	constexpr int sign(int v) { return (v>0) - (v<0); }
+	constexpr int rowOf(int square) { return square / N_COL; }
+	constexpr int colOf(int square) { return square % N_COL; }
+
+	// +1 or -1 per row towards the enemy
+	template <Team T> constexpr int forward = T==Team::black ?1 :-1;
+
+	template <Team T> constexpr bool inBase(int square) { return SquareNS::inBase(T, SquareNS::vectorOf(square)); }
+	template <Team T> constexpr bool inTeam(int square) { return SquareNS::inTeam(T, SquareNS::vectorOf(square)); }
+
+	// where a piece may ever stand, as Board::allowedSquares()
+	template <Kind K, Team T> constexpr bool isPlacement(int square) {
+		const Vector2d t = SquareNS::toTeam(T, SquareNS::vectorOf(square));
+		if constexpr (K == Kind::jiang) return inBase<T>(square);
+		else if constexpr (K == Kind::shi) return inBase<T>(square) && (t.x + t.y)%2 == 1;
+		else if constexpr (K == Kind::xiang) return inTeam<T>(square) && t.x%2==0 && t.y%2==0 && (t.x/2 + t.y/2)%2 == 1;
+		else if constexpr (K == Kind::zu) return !inTeam<T>(square) || (t.x>=3 && t.y%2==0);
+		else return true;
+	}
+
+	template <typename F> constexpr Bitboard maskOf(F f) {
+		Bitboard result = 0;
+		for (int i=0; i<N_SQUARE; ++i) {
+			if (f(i)) result |= BitboardNS::bit(i);
+		}
+		return result;
+	}
+
+	template <Team T> constexpr Bitboard palace = maskOf(inBase<T>);
+	template <Team T> constexpr Bitboard half = maskOf(inTeam<T>);
+	template <Kind K, Team T> constexpr Bitboard placement = maskOf(isPlacement<K, T>);
+
+	// placement<> of every (team, kind) at team*N_KIND + kind
+	constexpr std::array<Bitboard, 2*PieceNS::N_KIND> placements{
+		placement<Kind::jiang, Team::red>, placement<Kind::shi, Team::red>, placement<Kind::xiang, Team::red>,
+		placement<Kind::ma, Team::red>, placement<Kind::ju, Team::red>, placement<Kind::pao, Team::red>,
+		placement<Kind::zu, Team::red>,
+		placement<Kind::jiang, Team::black>, placement<Kind::shi, Team::black>, placement<Kind::xiang, Team::black>,
+		placement<Kind::ma, Team::black>, placement<Kind::ju, Team::black>, placement<Kind::pao, Team::black>,
+		placement<Kind::zu, Team::black>,
+	};
+
+	// Ma, Shi and Xiang moves in the order destOfDirection() tries them
+	template <Kind K> constexpr std::array<Offset, 8> steps{};
+	template <> constexpr std::array<Offset, 8> steps<Kind::ma>{{{2,1}, {1,2}, {-1,2}, {-2,1}, {-2,-1}, {-1,-2}, {1,-2}, {2,-1}}};
+	template <> constexpr std::array<Offset, 8> steps<Kind::shi>{{{1,1}, {1,-1}, {-1,-1}, {-1,1}}};
+	template <> constexpr std::array<Offset, 8> steps<Kind::xiang>{{{2,2}, {2,-2}, {-2,-2}, {-2,2}}};
+	template <Kind K> constexpr int nSteps = K==Kind::ma ?8 :K==Kind::shi || K==Kind::xiang ?4 :0;
+
+	// Whether the piece could move from `from` to `to` were it not for pieces of its own
+	// team standing there, as PieceNS::Base::isMoveCandidate().
+	template <Kind K, Team T> inline bool isMoveCandidate(const Board &board, const int from, const int to) {
+		assert(0<=from && from<N_SQUARE && 0<=to && to<N_SQUARE && from!=to);
+		assert(BitboardNS::test(placement<K, T>, from));
+
+		const int dx = rowOf(to) - rowOf(from), dy = colOf(to) - colOf(from);
+		if constexpr (K == Kind::ju) {
+			return BitboardNS::test(board.juTargets(from), to);
+		} else if constexpr (K == Kind::pao) {
+			return BitboardNS::test(board.paoTargets(from), to);
+		} else if constexpr (K == Kind::ma) {
+			const int leg = from + (dx - sign(dx))*N_COL + (dy - sign(dy));
+			return abs(dx*dy)==2 && !BitboardNS::test(board.occupancy(), leg);
+		} else if constexpr (K == Kind::shi) {
+			return BitboardNS::test(palace<T>, to) && abs(dx)==1 && abs(dy)==1;
+		} else if constexpr (K == Kind::xiang) {
+			const int eye = from + dx/2*N_COL + dy/2;
+			return BitboardNS::test(half<T>, to) && abs(dx)==2 && abs(dy)==2 && !BitboardNS::test(board.occupancy(), eye);
+		} else if constexpr (K == Kind::jiang) {
+			return BitboardNS::test(palace<T>, to) && abs(dx) + abs(dy) == 1;
+		} else {
+			const int ahead = dx * forward<T>;
+			return inTeam<T>(from) ?(ahead==1 && dy==0) :(ahead>=0 && ahead + abs(dy) == 1);
+		}
+	}
+
+	// The square named by the last two characters of a move like "m2j3", NO_SQUARE if
+	// none, as PieceNS::Base::destOfDirection(); direction is +1 for 'j' as black, 0 for 'p'.
+	template <Kind K, Team T> constexpr int destOfDirection(const int direction, const int from, const char c) {
+		assert(-1<=direction && direction<=1);
+		const int x = rowOf(from), y = colOf(from);
+
+		if constexpr (nSteps<K> == 0) {
+			assert('1'<=c && c-'1' < (direction==0 ?N_COL :N_ROW));
+			if (direction == 0) {
+				const int col = SquareNS::toTeam(T, {0, c - '1'}).y;
+				return col==y ?NO_SQUARE :x*N_COL + col;
+			}
+			const int row = x + direction*(c - '0');
+			return 0<=row && row<N_ROW ?row*N_COL + y :NO_SQUARE;
+		} else {
+			if (direction == 0) return NO_SQUARE;
+			assert('1'<=c && c<='9');
+			const int col = SquareNS::toTeam(T, {0, c - '1'}).y;
+			for (int i=0; i<nSteps<K>; ++i) {
+				const Offset d = steps<K>[i];
+				const int to = SquareNS::step(from, {d.dx, d.dy});
+				if (to==NO_SQUARE || colOf(to)!=col) continue;
+				if (d.dx*direction > 0) return to;
+			}
+			return NO_SQUARE;
+		}
+	}
+
+	template <Team T> inline bool isMoveCandidate(const Kind kind, const Board &board, const int from, const int to) {
+		switch (kind) {
+			case Kind::jiang: return isMoveCandidate<Kind::jiang, T>(board, from, to);
+			case Kind::shi: return isMoveCandidate<Kind::shi, T>(board, from, to);
+			case Kind::xiang: return isMoveCandidate<Kind::xiang, T>(board, from, to);
+			case Kind::ma: return isMoveCandidate<Kind::ma, T>(board, from, to);
+			case Kind::ju: return isMoveCandidate<Kind::ju, T>(board, from, to);
+			case Kind::pao: return isMoveCandidate<Kind::pao, T>(board, from, to);
+			case Kind::zu: return isMoveCandidate<Kind::zu, T>(board, from, to);
+		}
+		return false;
+	}
+
+	template <Team T> constexpr int destOfDirection(const Kind kind, const int direction, const int from, const char c) {
+		switch (kind) {
+			case Kind::jiang: return destOfDirection<Kind::jiang, T>(direction, from, c);
+			case Kind::shi: return destOfDirection<Kind::shi, T>(direction, from, c);
+			case Kind::xiang: return destOfDirection<Kind::xiang, T>(direction, from, c);
+			case Kind::ma: return destOfDirection<Kind::ma, T>(direction, from, c);
+			case Kind::ju: return destOfDirection<Kind::ju, T>(direction, from, c);
+			case Kind::pao: return destOfDirection<Kind::pao, T>(direction, from, c);
+			case Kind::zu: return destOfDirection<Kind::zu, T>(direction, from, c);
+		}
+		return NO_SQUARE;
+	}
+
+	inline bool isMoveCandidate(const Kind kind, const Team team, const Board &board, const int from, const int to) {
+		CCHESS_PROBE(static_cast<Instrument::Probe>(Instrument::isMoveCandidate + static_cast<int>(kind)));
+		return team==Team::red ?isMoveCandidate<Team::red>(kind, board, from, to) :isMoveCandidate<Team::black>(kind, board, from, to);
+	}
+
+	constexpr int destOfDirection(const Kind kind, const Team team, const int direction, const int from, const char c) {
+		return team==Team::red ?destOfDirection<Team::red>(kind, direction, from, c) :destOfDirection<Team::black>(kind, direction, from, c);
+	}
+}
+
+#endif
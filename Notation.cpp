@@ -0,0 +1,197 @@
+#include "Notation.hpp"
+#include "Bitboard.hpp"
+#include "Board.hpp"
+#include "Instrument.hpp"
+#include "Piece.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+using PieceNS::Kind;
+using std::array;
+using std::nullopt;
+using std::optional;
+using std::string_view;
+
+namespace Notation {
+	namespace {
+		// in PieceNS::Kind order
+		constexpr array<char, PieceNS::N_KIND> letterOfKind{
+			PieceNS::Jiang::nameEn[0], PieceNS::Shi::nameEn[0], PieceNS::Xiang::nameEn[0], PieceNS::Ma::nameEn[0],
+			PieceNS::Ju::nameEn[0], PieceNS::Pao::nameEn[0], PieceNS::Zu::nameEn[0],
+		};
+
+		// 'b' is accepted as a piece letter by the notation but names no piece
+		bool isPieceLetter(const char c) { return c=='b' || string_view{letterOfKind.data(), letterOfKind.size()}.find(c) != string_view::npos; }
+		bool isColumn(const char c) { return '1'<=c && c<='9'; }
+
+		optional<Kind> kindOfLetter(const char c) {
+			for (int k=0; k<PieceNS::N_KIND; ++k) {
+				if (letterOfKind[k] == c) return static_cast<Kind>(k);
+			}
+			return nullopt;
+		}
+
+		// the pieces of `team` and `kind` on the column numbered c (0-based) from `team`'s side
+		Bitboard onColumn(const Board &board, const Kind kind, const Team team, const int c) {
+			return board.piecesOf(kind, team) & BitboardNS::fileToBitboard(Board::colToTeam(team, c), (1 << Board::N_ROW) - 1);
+		}
+
+		// squares of `pieces` ordered from the front of `team`, i.e. from the enemy's side
+		int fromFront(Bitboard pieces, const Team team, array<int, Board::N_ROW> &squares) {
+			int n = 0;
+			while (pieces) squares[n++] = BitboardNS::popLowest(pieces);
+			if (team == Team::black) {
+				for (int i=0; i<n/2; ++i) std::swap(squares[i], squares[n-1-i]);
+			}
+			return n;
+		}
+
+		// the k-th (-1 for the last) of at least two `pieces`, as Board::parseKthPieceAtCol()
+		int kthFromFront(const Bitboard pieces, const Team team, const int k) {
+			array<int, Board::N_ROW> squares;
+			const int n = fromFront(pieces, team, squares);
+			if (n<2 || n<=k) return Board::NO_SQUARE;
+			return k==-1 ?squares[n-1] :squares[k];
+		}
+	}
+
+	string_view errorName(const Error e) {
+		switch (e) {
+			case Error::none: return "none";
+			case Error::syntax: return "syntax error";
+			case Error::noPiece: return "no such piece";
+			case Error::destination: return "no such destination";
+			case Error::notMoveable: return "move not allowed";
+			default: assert(false); // impossible
+		}
+		return {};
+	}
+
+	optional<Move> parse(const Board &board, const Team team, const string_view s, ParseError *error) {
+		CCHESS_PROBE(Instrument::notationParse);
+		const auto fail = [error](Error e, int column) -> optional<Move> {
+			if (error) *error = ParseError{e, 0, column};
+			return nullopt;
+		};
+
+		if (s.size() != 4) return fail(Error::syntax, 0);
+
+		int from = Board::NO_SQUARE;
+		if (isPieceLetter(s[0])) {
+			if (!isColumn(s[1])) return fail(Error::syntax, 1);
+			const optional<Kind> kind = kindOfLetter(s[0]);
+			if (!kind.has_value()) return fail(Error::noPiece, 0);
+
+			const Bitboard pieces = onColumn(board, *kind, team, s[1]-'1');
+			if (BitboardNS::popCount(pieces) != 1) return fail(Error::noPiece, 0);
+			from = BitboardNS::lowestSquare(pieces);
+		} else if (s[0]=='q' || s[0]=='h' || ('2'<=s[0] && s[0]<='5')) {
+			const int k = s[0]=='q' ?0 :s[0]=='h' ?-1 :s[0]-'1';
+			if (isColumn(s[1])) {
+				from = kthFromFront(onColumn(board, Kind::zu, team, s[1]-'1'), team, k);
+			} else if (isPieceLetter(s[1])) {
+				const optional<Kind> kind = kindOfLetter(s[1]);
+				if (!kind.has_value()) return fail(Error::noPiece, 0);
+
+				// only one column may hold a k-th piece
+				for (int c=0; c<Board::N_COL; ++c) {
+					const int p = kthFromFront(onColumn(board, *kind, team, c), team, k);
+					if (p == Board::NO_SQUARE) continue;
+					if (from != Board::NO_SQUARE) return fail(Error::noPiece, 0);
+					from = p;
+				}
+			} else {
+				return fail(Error::syntax, 1);
+			}
+			if (from == Board::NO_SQUARE) return fail(Error::noPiece, 0);
+		} else {
+			return fail(Error::syntax, 0);
+		}
+
+		if (s[2]!='j' && s[2]!='t' && s[2]!='p') return fail(Error::syntax, 2);
+		if (!isColumn(s[3])) return fail(Error::syntax, 3);
+
+		const optional<Vector2d> to = board.parseDestByDirection(Board::vectorOf(from), s[2], s[3]);
+		if (!to.has_value()) return fail(Error::destination, 2);
+
+		if (error) *error = ParseError{};
+		return Move{static_cast<std::uint8_t>(from), static_cast<std::uint8_t>(Board::indexOf(*to))};
+	}
+
+	int parseMoves(Board &board, const string_view *moves, const int n, Move *out, ParseError &error) {
+		error = ParseError{};
+		for (int i=0; i<n; ++i) {
+			const optional<Move> m = parse(board, board.sideToMove(), moves[i], &error);
+			if (!m.has_value()) {
+				error.move = i;
+				return i;
+			}
+			if (!board.isMoveable(Board::vectorOf(m->from), Board::vectorOf(m->to))) {
+				error = ParseError{Error::notMoveable, i, 0};
+				return i;
+			}
+
+			board.makeMove(*m);
+			out[i] = *m;
+		}
+		return n;
+	}
+
+	array<char, 4> format(const Board &board, const Move m) {
+		const Board::PieceId id = board.idAt(Board::vectorOf(m.from));
+		assert(id != Board::NO_PIECE);
+
+		const Team team = PieceNS::teamOf(id);
+		const Kind kind = PieceNS::kindOf(id);
+		const Vector2d from = Board::vectorOf(m.from), to = Board::vectorOf(m.to);
+		const int col = Board::colToTeam(team, from.y);
+
+		array<char, 4> result;
+		array<int, Board::N_ROW> squares{};
+		const int n = fromFront(onColumn(board, kind, team, col), team, squares);
+		if (n == 1) {
+			result[0] = letterOfKind[static_cast<int>(kind)];
+			result[1] = '1' + col;
+		} else {
+			int k = 0;
+			while (k<n && squares[k]!=m.from) ++k;
+			assert(k < n);
+			result[0] = k==0 ?'q' :k==n-1 ?'h' :'1'+k;
+			// at most one column holds two of any other kind, so the letter is enough
+			result[1] = kind==Kind::zu ?'1'+col :letterOfKind[static_cast<int>(kind)];
+		}
+
+		const int advance = team==Team::black ?to.x-from.x :from.x-to.x;
+		result[2] = advance>0 ?'j' :advance<0 ?'t' :'p';
+		const bool straight = kind==Kind::ju || kind==Kind::pao || kind==Kind::jiang || kind==Kind::zu;
+		result[3] = advance!=0 && straight ?'0'+std::abs(advance) :'1'+Board::colToTeam(team, to.y);
+		return result;
+	}
+
+	namespace {
+		// an ICCS square: rank 0 is red's back rank, row N_ROW-1 of the board
+		optional<int> parseIccsSquare(const char file, const char rank) {
+			if (file<'a' || file>='a'+Board::N_COL || rank<'0' || rank>='0'+Board::N_ROW) return nullopt;
+			return Board::indexOf({Board::N_ROW-1 - (rank-'0'), file-'a'});
+		}
+	}
+
+	optional<Move> parseIccs(const string_view s) {
+		if (s.size() != 4) return nullopt;
+		const optional<int> from = parseIccsSquare(s[0], s[1]), to = parseIccsSquare(s[2], s[3]);
+		if (!from.has_value() || !to.has_value() || *from==*to) return nullopt;
+		return Move{static_cast<std::uint8_t>(*from), static_cast<std::uint8_t>(*to)};
+	}
+
+	array<char, 4> formatIccs(const Move m) {
+		const Vector2d from = Board::vectorOf(m.from), to = Board::vectorOf(m.to);
+		return {
+			static_cast<char>('a' + from.y), static_cast<char>('0' + Board::N_ROW-1 - from.x),
+			static_cast<char>('a' + to.y), static_cast<char>('0' + Board::N_ROW-1 - to.x),
+		};
+	}
+}
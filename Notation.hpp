@@ -0,0 +1,48 @@
+#ifndef NOTATION_HPP
+#define NOTATION_HPP
+
+#include <array>
+#include <optional>
+#include <string_view>
+
+#include "Board.hpp"
+#include "Move.hpp"
+
+// The four-character move notation read by the REPL: piece and column (j2, or q/h/2-5
+// plus column or piece for several pieces on one column), then j/t/p and a column or a
+// number of steps, all counted from the mover's side, e.g. p2p5, m8j7, qmj3, 2z1p2.
+// Nothing here allocates.
+namespace Notation {
+	enum class Error {
+		none,
+		syntax,       // not of the form above
+		noPiece,      // no piece, or not exactly one, matches the first two characters
+		destination,  // the piece has no destination for the last two characters
+		notMoveable,  // Board::isMoveable() rejects the move
+	};
+
+	std::string_view errorName(Error);
+
+	struct ParseError {
+		Error error = Error::none;
+		int move = 0;   // index of the move that failed
+		int column = 0; // first character of that move found at fault
+	};
+
+	// the move `s` of `team` on `board`, without checking isMoveable()
+	std::optional<Move> parse(const Board &board, Team team, std::string_view s, ParseError *error = nullptr);
+
+	// Resolves moves[0..n) in turn for the side to move, playing each on `board` and writing
+	// it to out[i]. Returns how many were resolved; if fewer than n, `error` says why.
+	int parseMoves(Board &board, const std::string_view *moves, int n, Move *out, ParseError &error);
+
+	// the notation parse() reads back as `m`, for a move isMoveable() accepts
+	std::array<char, 4> format(const Board &board, Move m);
+
+	// ICCS coordinates as UCCI speaks them: file a-i from red's left and rank 0-9 from red's
+	// side, from and to, e.g. h2e2. Only the syntax is checked, not the board.
+	std::optional<Move> parseIccs(std::string_view s);
+	std::array<char, 4> formatIccs(Move m);
+}
+
+#endif
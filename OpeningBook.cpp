@@ -0,0 +1,182 @@
+#include "OpeningBook.hpp"
+#include "GameRecord.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::vector;
+
+namespace {
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t entrySize;
+		std::uint64_t count;
+	};
+
+	constexpr char MAGIC[8] = {'C', 'C', 'H', 'B', 'O', 'O', 'K', '\0'};
+	constexpr std::uint32_t VERSION = 1;
+
+	static_assert(sizeof(Header) == 24 && sizeof(OpeningBook::Entry) == 32, "the file layout depends on these");
+	static_assert(std::is_trivially_copyable_v<OpeningBook::Entry>);
+
+	// interpolation steps before falling back to binary search, which bounds the cost
+	// when the keys are not spread evenly
+	constexpr int MAX_INTERPOLATIONS = 8;
+	// ranges this short are searched by bisection
+	constexpr size_t MIN_INTERPOLATION_RANGE = 16;
+
+	// one move from one position of one game, before counting
+	struct Occurrence {
+		std::uint64_t key;
+		Move move;
+		std::int8_t outcome; // for the mover: 1 win, 0 draw, -1 loss, 2 unknown
+
+		bool operator <(const Occurrence &other) const {
+			if (key != other.key) return key < other.key;
+			if (move.from != other.move.from) return move.from < other.move.from;
+			return move.to < other.move.to;
+		}
+	};
+
+	std::int8_t outcomeFor(const GameRecord::Result result, const Team mover) {
+		switch (result) {
+			case GameRecord::Result::redWin: return mover==Team::red ?1 :-1;
+			case GameRecord::Result::blackWin: return mover==Team::black ?1 :-1;
+			case GameRecord::Result::draw: return 0;
+			case GameRecord::Result::unknown: return 2;
+		}
+		return 2;
+	}
+}
+
+optional<OpeningBook> OpeningBook::open(const char *path) {
+	optional<MappedFile> file = MappedFile::open(path);
+	if (!file.has_value() || file->size() < sizeof(Header)) return nullopt;
+
+	Header header;
+	std::memcpy(&header, file->data(), sizeof header);
+	if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) || header.version!=VERSION || header.entrySize!=sizeof(Entry)) return nullopt;
+	if (header.count != (file->size() - sizeof(Header)) / sizeof(Entry) || (file->size() - sizeof(Header)) % sizeof(Entry)) return nullopt;
+
+	// lookups jump around the file, so read-ahead would only waste the page cache
+	file->adviseRandom();
+	const Entry *entries = reinterpret_cast<const Entry *>(file->data() + sizeof(Header));
+	return OpeningBook{std::move(*file), entries, static_cast<size_t>(header.count)};
+}
+
+const OpeningBook::Entry *OpeningBook::lowerBound(const std::uint64_t key) const {
+	// the first entry with a key >= `key` is in [lo, hi]
+	size_t lo = 0, hi = count;
+	for (int step=0; step<MAX_INTERPOLATIONS && hi-lo>MIN_INTERPOLATION_RANGE; ++step) {
+		const std::uint64_t first = entries[lo].key, last = entries[hi-1].key;
+		if (key <= first) return entries + lo;
+		if (key > last) return entries + hi;
+
+		// Zobrist keys are close to uniform, so the key's share of the range is a good guess
+		const double share = static_cast<double>(key - first) / static_cast<double>(last - first);
+		const size_t mid = std::min(hi-1, lo + static_cast<size_t>(share * (hi-1-lo)));
+		if (entries[mid].key < key) lo = mid + 1;
+		else hi = mid;
+	}
+	return std::lower_bound(entries+lo, entries+hi, key, [](const Entry &e, std::uint64_t k) { return e.key < k; });
+}
+
+OpeningBook::Range OpeningBook::moves(const std::uint64_t key) const {
+	const Entry *begin = lowerBound(key);
+	const Entry *end = begin;
+	while (end!=entries+count && end->key==key) ++end;
+	return Range{begin, end};
+}
+
+optional<Move> OpeningBook::bestMove(const Board &board) const {
+	const Range range = moves(board);
+	if (range.empty()) return nullopt;
+
+	// a key collision could name a move of another position, even one from an empty
+	// square or of the other side, and a corrupt file one off the board, so only the
+	// legal moves of this one are taken
+	const MoveList legal = board.generateMoves(board.sideToMove());
+	const Entry *best = nullptr;
+	for (const Entry &e: range) {
+		if (std::find(legal.begin(), legal.end(), e.move) == legal.end()) continue;
+		if (!best || e.games>best->games) best = &e;
+	}
+	if (!best) return nullopt;
+	return best->move;
+}
+
+optional<OpeningBook::BuildStats> OpeningBook::build(const char *archivePath, const char *bookPath, const BuildOptions &options, std::ostream &log) {
+	const optional<MappedFile> archive = MappedFile::open(archivePath);
+	if (!archive.has_value()) return nullopt;
+
+	const auto begin = std::chrono::steady_clock::now();
+	BuildStats stats;
+	vector<Occurrence> occurrences;
+	GameRecord::Reader reader{archive->view()};
+	for (std::uint64_t index=0; const optional<GameRecord::Game> game = reader.next(); ++index) {
+		const size_t first = occurrences.size();
+		Board board = Board::makeStandardBoard();
+		int ply = 0;
+		const GameRecord::Replay r = GameRecord::replay(*game, board, [&](const Board &b, Move m) {
+			if (ply++ < options.maxPlies) occurrences.push_back(Occurrence{b.key(), m, 0});
+		});
+		if (!r.ok()) {
+			occurrences.resize(first);
+			++stats.malformed;
+			log <<"game " <<index+1 <<" at byte " <<game->offset <<": " <<Notation::errorName(r.error.error)
+				<<" in move " <<r.error.move+1 <<", skipped\n";
+			continue;
+		}
+
+		++stats.games;
+		Team mover = Team::red;
+		for (size_t i=first; i<occurrences.size(); ++i) {
+			occurrences[i].outcome = outcomeFor(r.result, mover);
+			mover = otherTeam(mover);
+		}
+	}
+	stats.positions = occurrences.size();
+
+	std::sort(occurrences.begin(), occurrences.end());
+	vector<Entry> entries;
+	for (size_t i=0; i<occurrences.size(); ) {
+		Entry e{occurrences[i].key, occurrences[i].move, 0, 0, 0, 0, 0, 0};
+		for (; i<occurrences.size() && occurrences[i].key==e.key && occurrences[i].move==e.move; ++i) {
+			++e.games;
+			switch (occurrences[i].outcome) {
+				case 1: ++e.wins; break;
+				case 0: ++e.draws; break;
+				case -1: ++e.losses; break;
+			}
+		}
+		if (e.games >= options.minGames) entries.push_back(e);
+	}
+	stats.entries = entries.size();
+
+	Header header;
+	std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+	header.version = VERSION;
+	header.entrySize = sizeof(Entry);
+	header.count = entries.size();
+
+	std::ofstream out{bookPath, std::ios::binary | std::ios::trunc};
+	out.write(reinterpret_cast<const char *>(&header), sizeof header);
+	out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+	out.close();
+	if (!out) return nullopt;
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return stats;
+}
@@ -0,0 +1,80 @@
+#ifndef OPENING_BOOK_HPP
+#define OPENING_BOOK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <utility>
+
+#include "Board.hpp"
+#include "MappedFile.hpp"
+#include "Move.hpp"
+
+// Moves played from each position of a game corpus, with how the games went. The file is
+// a header and an array of Entry sorted by key then move, used in place through a
+// read-only mapping, so opening a book reads nothing and processes sharing one book share
+// its pages in the page cache. Integers are stored in host byte order.
+class OpeningBook {
+	public:
+		struct Entry {
+			std::uint64_t key; // Board::key() of the position the move is played from
+			Move move;
+			std::uint16_t reserved;
+			// games playing the move, and how many of them the mover won, drew and lost
+			std::uint32_t games, wins, draws, losses;
+			std::uint32_t reserved2;
+
+			// the mover's score over the games with a known result, 0.5 if there are none
+			double winRate() const {
+				const std::uint32_t decided = wins + draws + losses;
+				return decided>0 ?(wins + 0.5*draws)/decided :0.5;
+			}
+		};
+
+		// the entries of one position, in move order
+		struct Range {
+			const Entry *begin_, *end_;
+
+			const Entry *begin() const { return begin_; }
+			const Entry *end() const { return end_; }
+			std::size_t size() const { return end_ - begin_; }
+			bool empty() const { return begin_ == end_; }
+		};
+
+		struct BuildOptions {
+			int maxPlies = 40;          // positions deeper into a game are left out
+			std::uint32_t minGames = 1; // moves played in fewer games are left out
+		};
+
+		struct BuildStats {
+			std::uint64_t games = 0, malformed = 0, positions = 0, entries = 0;
+			double seconds = 0;
+		};
+
+	private:
+		MappedFile file;
+		const Entry *entries;
+		std::size_t count;
+
+		OpeningBook(MappedFile file_, const Entry *entries_, std::size_t count_)
+			: file(std::move(file_)), entries(entries_), count(count_) { }
+
+		const Entry *lowerBound(std::uint64_t key) const;
+
+	public:
+		// nullopt if the file cannot be read or is not a book
+		static std::optional<OpeningBook> open(const char *path);
+		// Counts the moves of every well-formed game of the GameRecord archive at
+		// `archivePath` and writes the book to `bookPath`; nullopt if either file fails.
+		static std::optional<BuildStats> build(const char *archivePath, const char *bookPath, const BuildOptions &options, std::ostream &log);
+
+		std::size_t size() const { return count; }
+		// the entries as stored, whose moves a corrupt file may have off the board
+		Range moves(std::uint64_t key) const;
+		Range moves(const Board &board) const { return moves(board.key()); }
+		// the most played book move of the position, if any
+		std::optional<Move> bestMove(const Board &board) const;
+};
+
+#endif
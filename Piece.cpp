@@ -1,177 +1,76 @@
 #include <cassert>
-#include <memory>
-#include <vector>
+#include <optional>
 
 #include "Board.hpp"
+#include "MoveKernel.hpp"
 #include "Piece.hpp"
 #include "Vector2d.hpp"
 
 using std::optional;
 using std::nullopt;
-using std::vector;
 
 namespace PieceNS {
-		optional<Vector2d> Base::destOfDirectionStraight(int direction, Vector2d from, char c) const {
-			assert (-1 <= direction && direction <= 1);
-			assert('1' <= c && c-'1' < (direction==0 ?Board::N_COL :Board::N_ROW));
-
-			if (direction==0) {
-				const int k = c - '1';
-				if (k==from.y) return nullopt;
-				return Vector2d{from.x, Board::colToTeam(team, k)};
-			} else {
-				const int k = c - '0';
-				Vector2d p{from.x+direction*k, from.y};
-				if (Board::inBound(p)) return p;
-				return nullopt;
-			}
+	namespace {
+		// the kernels of MoveKernel for the team of an instance
+		template <Kind K> bool isCandidate(const Team team, const Board &board, const Vector2d from, const Vector2d to) {
+			assert(Board::inBound(from));
+			assert(Board::inBound(to));
+			assert(from != to);
+			return MoveKernel::isMoveCandidate(K, team, board, Board::indexOf(from), Board::indexOf(to));
 		}
 
-		optional<Vector2d> Base::destOfDirectionsByCandidates(const vector<Vector2d> &dirCandidates, int direction, Vector2d from, char c) const {
-			assert (-1 <= direction && direction <= 1);
-
-			if (direction==0) return nullopt;
-
-			int k = Board::colToTeam(team, c-'1');
-			for (Vector2d d: dirCandidates) {
-				Vector2d p = from + d;
-				if (!Board::inBound(p) || p.y != k) continue;
-				if ((p.x - from.x) * direction > 0) return p;
-			}
-
-			return nullopt;
+		template <Kind K> optional<Vector2d> destOf(const Team team, const int direction, const Vector2d from, const char c) {
+			const int to = MoveKernel::destOfDirection(K, team, direction, Board::indexOf(from), c);
+			if (to == MoveKernel::NO_SQUARE) return nullopt;
+			return Board::vectorOf(to);
 		}
 
-	bool Ju::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-
-		return board.countPiecesBetween(from, to).value_or(-1) == 0;
-	}
-
-	optional<Vector2d> Ju::destOfDirection(int direction, Vector2d from, char c) const {
-		return destOfDirectionStraight(direction, from, c);
-	}
-
-	bool Ma::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-
-		Vector2d d{to - from};
-		if (abs(d.x * d.y) != 2) {
-			return false;
+		template <Kind K> bool isPlacement(const Team team, const Vector2d p) {
+			assert(Board::inBound(p));
+			return BitboardNS::test(MoveKernel::placements[static_cast<int>(team)*N_KIND + static_cast<int>(K)], Board::indexOf(p));
 		}
-
-		d -= d.quandrant();
-		if (board.pieceExist(from+d)) {
-			return false;
-		}
-
-		return true;
-	}
-
-	optional<Vector2d> Ma::destOfDirection(int direction, Vector2d from, char c) const {
-		static const vector<Vector2d> dirs{{{2,1}, {1,2}, {-1,2}, {-2,1}, {-2,-1}, {-1,-2}, {1,-2}, {2,-1}}};
-		return destOfDirectionsByCandidates(dirs, direction, from, c);
-	}
-
-	bool Pao::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-
-		const optional<int> v{board.countPiecesBetween(from, to)};
-		if (!v.has_value()) return false;
-		if (*v == 0) return !board.pieceExist(to);
-		return *v==1 && board.pieceExist(to);
-	}
-
-	optional<Vector2d> Pao::destOfDirection(int direction, Vector2d from, char c) const {
-		return destOfDirectionStraight(direction, from, c);
 	}
 
-	bool Shi::isShiPosition(const Vector2d p) const {
-		if (!Board::inBase(team, p)) return false;
-		const Vector2d pt = Board::toTeam(team, p);
-		return (pt.x + pt.y)%2 == 1;
-	}
+	bool Ju::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::ju>(team, board, from, to); }
+	optional<Vector2d> Ju::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::ju>(team, direction, from, c); }
 
-	bool Shi::isMoveCandidate(const Board &, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-		assert(isShiPosition(from));
+	bool Ma::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::ma>(team, board, from, to); }
+	optional<Vector2d> Ma::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::ma>(team, direction, from, c); }
 
-		if (!Board::inBase(team, to)) return false;
+	bool Pao::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::pao>(team, board, from, to); }
+	optional<Vector2d> Pao::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::pao>(team, direction, from, c); }
 
-		const Vector2d d{to - from};
-		return abs(d.x)==1 && abs(d.y)==1;
-	}
-
-	optional<Vector2d> Shi::destOfDirection(int direction, Vector2d from, char c) const {
-		static const vector<Vector2d> dirs{{{1,1}, {1,-1}, {-1,-1}, {-1,1}}};
-		return destOfDirectionsByCandidates(dirs, direction, from, c);
-	}
+	bool Shi::isShiPosition(const Vector2d p) const { return isPlacement<Kind::shi>(team, p); }
+	bool Shi::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::shi>(team, board, from, to); }
+	optional<Vector2d> Shi::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::shi>(team, direction, from, c); }
 
-	bool Xiang::isXiangPosition(const Vector2d p) const {
-		if (!Board::inTeam(team, p)) return false;
-		const Vector2d pt = Board::toTeam(team, p);
-		return pt.x%2==0 && pt.y%2==0 && (pt.x/2 + pt.y/2)%2 == 1;
-	}
+	bool Xiang::isXiangPosition(const Vector2d p) const { return isPlacement<Kind::xiang>(team, p); }
+	bool Xiang::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::xiang>(team, board, from, to); }
+	optional<Vector2d> Xiang::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::xiang>(team, direction, from, c); }
 
-	bool Xiang::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-		assert(isXiangPosition(from));
+	bool Jiang::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::jiang>(team, board, from, to); }
+	optional<Vector2d> Jiang::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::jiang>(team, direction, from, c); }
 
-		if (!Board::inTeam(team, to)) return false;
+	bool Zu::isZuPosition(const Vector2d p) const { return isPlacement<Kind::zu>(team, p); }
+	bool Zu::isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const { return isCandidate<Kind::zu>(team, board, from, to); }
+	optional<Vector2d> Zu::destOfDirection(int direction, Vector2d from, char c) const { return destOf<Kind::zu>(team, direction, from, c); }
 
-		const Vector2d d{to - from};
-		return abs(d.x)==2 && abs(d.y)==2 && !board.pieceExist(from + d.quandrant());
-	}
+	namespace {
+		const Jiang jiangs[2]{Team::red, Team::black};
+		const Shi shis[2]{Team::red, Team::black};
+		const Xiang xiangs[2]{Team::red, Team::black};
+		const Ma mas[2]{Team::red, Team::black};
+		const Ju jus[2]{Team::red, Team::black};
+		const Pao paos[2]{Team::red, Team::black};
+		const Zu zus[2]{Team::red, Team::black};
 
-	optional<Vector2d> Xiang::destOfDirection(int direction, Vector2d from, char c) const {
-		static const vector<Vector2d> dirs{{{2,2}, {2,-2}, {-2,-2}, {-2,2}}};
-		return destOfDirectionsByCandidates(dirs, direction, from, c);
+		const Base *const flyweights[N_KIND][2]{
+			{&jiangs[0], &jiangs[1]}, {&shis[0], &shis[1]}, {&xiangs[0], &xiangs[1]}, {&mas[0], &mas[1]},
+			{&jus[0], &jus[1]}, {&paos[0], &paos[1]}, {&zus[0], &zus[1]},
+		};
 	}
 
-	bool Jiang::isMoveCandidate(const Board &, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-		assert(Board::inBase(team, from));
-
-		if (!Board::inBase(team, to)) return false;
-
-		const Vector2d d{to - from};
-		return abs(d.x) + abs(d.y) == 1;
+	const Base &pieceOf(Kind kind, Team team) {
+		return *flyweights[static_cast<int>(kind)][static_cast<int>(team)];
 	}
-
-	optional<Vector2d> Jiang::destOfDirection(int direction, Vector2d from, char c) const {
-		return destOfDirectionStraight(direction, from, c);
-	}
-
-	bool Zu::isZuPosition(const Vector2d p) const {
-		if (!Board::inTeam(team, p)) return true;
-		const Vector2d pt = Board::toTeam(team, p);
-		return pt.x>=3 && pt.y%2==0;
-	}
-
-	bool Zu::isMoveCandidate(const Board &, const Vector2d from, const Vector2d to) const {
-		assert(Board::inBound(from));
-		assert(Board::inBound(to));
-		assert(from != to);
-		assert(isZuPosition(from));
-
-		const Vector2d d{Board::toTeam(team, to) - Board::toTeam(team, from)};
-		return Board::inTeam(team, from) ?(d.x==1 && d.y==0) :(d.x>=0 && d.x+abs(d.y)==1);
-	}
-
-	optional<Vector2d> Zu::destOfDirection(int direction, Vector2d from, char c) const {
-		return destOfDirectionStraight(direction, from, c);
-	}
-
 }
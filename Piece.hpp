@@ -1,9 +1,11 @@
 #ifndef PIECE_HPP
 #define PIECE_HPP
 
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <vector>
 
 #include "Team.hpp"
 #include "Vector2d.hpp"
@@ -14,10 +16,28 @@ namespace PieceNS {
 	using std::u32string_view;
 	using std::string_view;
 
+	enum class Kind : std::uint8_t { jiang, shi, xiang, ma, ju, pao, zu };
+	constexpr int N_KIND = 7;
+
+	// every piece of a position owns a fixed slot, 16 per team:
+	// jiang 0, shi 1-2, xiang 3-4, ma 5-6, ju 7-8, pao 9-10, zu 11-15
+	constexpr int N_SLOT_TEAM = 16;
+	constexpr int N_SLOT = 2 * N_SLOT_TEAM;
+	constexpr std::array<int, N_KIND+1> firstSlotOfKind{0, 1, 3, 5, 7, 9, 11, N_SLOT_TEAM};
+
+	// ids stored in Board squares, offset so that 0 means empty
+	constexpr std::uint8_t FIRST_ID = 16;
+
+	constexpr int slotOf(std::uint8_t id) { return id - FIRST_ID; }
+	constexpr std::uint8_t idOfSlot(Team team, int slotInTeam) { return FIRST_ID + static_cast<int>(team)*N_SLOT_TEAM + slotInTeam; }
+	constexpr Team teamOf(std::uint8_t id) { return static_cast<Team>(slotOf(id) / N_SLOT_TEAM); }
+	constexpr std::array<Kind, N_SLOT_TEAM> kindOfSlotInTeam{
+		Kind::jiang, Kind::shi, Kind::shi, Kind::xiang, Kind::xiang, Kind::ma, Kind::ma, Kind::ju,
+		Kind::ju, Kind::pao, Kind::pao, Kind::zu, Kind::zu, Kind::zu, Kind::zu, Kind::zu,
+	};
+	constexpr Kind kindOf(std::uint8_t id) { return kindOfSlotInTeam[slotOf(id) % N_SLOT_TEAM]; }
+
 	class Base {
-		protected:
-			std::optional<Vector2d> destOfDirectionStraight(int direction, Vector2d from, char c) const;
-			std::optional<Vector2d> destOfDirectionsByCandidates(const std::vector<Vector2d> &dirCandidates, int direction, Vector2d from, char c) const;
 		public:
 			const Team team;
 
@@ -33,6 +53,7 @@ namespace PieceNS {
 					case Team::black: return getNameBlack();
 					default: assert(false); // impossible
 				}
+				return {};
 			}
 
 			virtual bool isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const = 0;
@@ -135,6 +156,10 @@ namespace PieceNS {
 			bool isMoveCandidate(const Board &board, const Vector2d from, const Vector2d to) const override;
 			std::optional<Vector2d> destOfDirection(int direction, Vector2d from, char) const override;
 	};
+
+	// stateless per (kind, team) instances shared by every Board
+	const Base &pieceOf(Kind kind, Team team);
+	inline const Base &pieceOf(std::uint8_t id) { return pieceOf(kindOf(id), teamOf(id)); }
 }
 
 using Piece = PieceNS::Base;
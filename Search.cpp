@@ -0,0 +1,325 @@
+#include "Search.hpp"
+#include "Evaluator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using PieceNS::Kind;
+using std::array;
+using std::max;
+using std::min;
+using std::uint64_t;
+
+using Evaluator::evaluate;
+using Evaluator::materialValue;
+
+namespace {
+	// mate scores are stored relative to the node, not the root
+	int scoreToTable(const int score, const int ply) {
+		return score >= Search::MATE - Search::MAX_PLY ?score + ply : score <= -Search::MATE + Search::MAX_PLY ?score - ply : score;
+	}
+
+	int scoreFromTable(const int score, const int ply) {
+		return score >= Search::MATE - Search::MAX_PLY ?score - ply : score <= -Search::MATE + Search::MAX_PLY ?score + ply : score;
+	}
+
+	constexpr int TT_MOVE_SCORE = 1 << 30;
+	constexpr int CAPTURE_SCORE = 1 << 29;
+	constexpr int KILLER_SCORE = 1 << 28;
+
+	// the next best-scored move is swapped to position i
+	void pickNext(MoveList &moves, array<int, MoveList::CAPACITY> &scores, const int i) {
+		int best = i;
+		for (int j=i+1; j<moves.size(); ++j) {
+			if (scores[j] > scores[best]) best = j;
+		}
+		std::swap(moves[i], moves[best]);
+		std::swap(scores[i], scores[best]);
+	}
+}
+
+void Search::setThreads(const int n) {
+	assert(n >= 1);
+	helpers.resize(n - 1);
+	for (int i=0; i<n-1; ++i) {
+		if (!helpers[i]) helpers[i] = std::make_unique<Search>(tt);
+		helpers[i]->helperIndex = i + 1;
+		helpers[i]->tablebases = tablebases;
+	}
+}
+
+void Search::setTablebases(const Tablebases *t) {
+	tablebases = t;
+	for (const std::unique_ptr<Search> &h: helpers) h->tablebases = t;
+}
+
+void Search::stop() {
+	stopRequested.store(true, std::memory_order_relaxed);
+	for (const std::unique_ptr<Search> &h: helpers) h->stop();
+}
+
+uint64_t Search::totalNodes() const {
+	uint64_t result = nodes.load(std::memory_order_relaxed);
+	for (const std::unique_ptr<Search> &h: helpers) result += h->nodes.load(std::memory_order_relaxed);
+	return result;
+}
+
+bool Search::checkStop() {
+	if (stopped) return true;
+	if (stopRequested.load(std::memory_order_relaxed)) return stopped = true;
+
+	const uint64_t n = nodes.load(std::memory_order_relaxed);
+	if (limits.nodes) {
+		// the helpers' counters are only summed now and then
+		const uint64_t searched = helpers.empty() ?n :(n & 1023)==0 ?totalNodes() :0;
+		if (searched >= limits.nodes) return stopped = true;
+	}
+	if (limits.movetimeMs && (n & 1023) == 0
+			&& Clock::now() - start >= std::chrono::milliseconds(limits.movetimeMs)) {
+		return stopped = true;
+	}
+	return false;
+}
+
+void Search::orderMoves(MoveList &moves, array<int, MoveList::CAPACITY> &scores, const Move ttMove, const int ply) const {
+	for (int i=0; i<moves.size(); ++i) {
+		const Move m = moves[i];
+		const Board::PieceId victim = board.idAt(Board::vectorOf(m.to));
+		if (m == ttMove) {
+			scores[i] = TT_MOVE_SCORE;
+		} else if (victim != Board::NO_PIECE) {
+			const Kind attacker = PieceNS::kindOf(board.idAt(Board::vectorOf(m.from)));
+			scores[i] = CAPTURE_SCORE + 16*materialValue[static_cast<int>(PieceNS::kindOf(victim))] - materialValue[static_cast<int>(attacker)];
+		} else if (m == killers[ply][0] || m == killers[ply][1]) {
+			scores[i] = KILLER_SCORE + (m == killers[ply][0]);
+		} else {
+			scores[i] = history[m.from][m.to];
+		}
+	}
+}
+
+int Search::quiescence(const int ply, int alpha, const int beta) {
+	if (checkStop()) return 0;
+	countNode();
+
+	const int standPat = evaluate(board);
+	if (ply >= MAX_PLY-1 || standPat >= beta) return standPat;
+	alpha = max(alpha, standPat);
+
+	const Team us = board.sideToMove();
+	MoveList moves{board.generatePseudoLegalCaptures(us)};
+	array<int, MoveList::CAPACITY> scores;
+	orderMoves(moves, scores, NO_MOVE, ply);
+
+	int best = standPat;
+	for (int i=0; i<moves.size(); ++i) {
+		pickNext(moves, scores, i);
+		const Undo undo{board.makeMove(moves[i])};
+		if (board.isInCheck(us)) {
+			board.unmakeMove(undo);
+			continue;
+		}
+		const int score = -quiescence(ply+1, -beta, -alpha);
+		board.unmakeMove(undo);
+		if (stopped) return 0;
+
+		if (score > best) {
+			best = score;
+			if (score >= beta) break;
+			alpha = max(alpha, score);
+		}
+	}
+
+	return best;
+}
+
+int Search::negamax(int depth, const int ply, int alpha, const int beta) {
+	// the tables are exact, so a position found there needs no search at any depth
+	if (ply>0 && tablebases) {
+		if (const std::optional<Tablebase::Probe> p{tablebases->probe(board)}) {
+			return p->wdl==Tablebase::Wdl::draw ?0 :p->wdl==Tablebase::Wdl::win ?MATE - ply - p->dtm :-MATE + ply + p->dtm;
+		}
+	}
+
+	const Team us = board.sideToMove();
+	if (ply > 0) {
+		if (const int plies = line.lastRepeat()) {
+			const std::optional<Team> loser = line.classify(board, plies).loser();
+			return !loser.has_value() ?0 :*loser==us ?-MATE + ply :MATE - ply;
+		}
+	}
+
+	const bool inCheck = board.isInCheck(us);
+	if (inCheck) ++depth;
+	if (depth <= 0) return quiescence(ply, alpha, beta);
+	if (checkStop()) return 0;
+	countNode();
+	if (ply >= MAX_PLY-1) return evaluate(board);
+
+	const int alphaOrig = alpha;
+	Move ttMove = NO_MOVE;
+	++ttProbes;
+	if (const std::optional<TranspositionTable::Entry> e{tt.probe(board.key())}) {
+		++ttHits;
+		ttMove = e->move;
+		const int score = scoreFromTable(e->score, ply);
+		if (ply>0 && e->depth>=depth) {
+			using Bound = TranspositionTable::Bound;
+			if (e->bound==Bound::exact
+					|| (e->bound==Bound::lower && score>=beta)
+					|| (e->bound==Bound::upper && score<=alpha)) {
+				return score;
+			}
+		}
+	}
+
+	MoveList moves{board.generatePseudoLegalMoves(us)};
+	array<int, MoveList::CAPACITY> scores;
+	orderMoves(moves, scores, ttMove, ply);
+
+	int best = -INF;
+	Move bestMove = NO_MOVE;
+	int legal = 0;
+	for (int i=0; i<moves.size(); ++i) {
+		pickNext(moves, scores, i);
+		const Move m = moves[i];
+		const bool quiet = !board.pieceExist(Board::vectorOf(m.to));
+		const Undo undo{board.makeMove(m)};
+		if (board.isInCheck(us)) {
+			board.unmakeMove(undo);
+			continue;
+		}
+		++legal;
+		line.push(board, undo);
+		const int score = -negamax(depth-1, ply+1, -beta, -alpha);
+		line.pop();
+		board.unmakeMove(undo);
+		if (stopped) return 0;
+
+		if (score <= best) continue;
+		best = score;
+		bestMove = m;
+		if (ply == 0) rootBest = m;
+		if (score <= alpha) continue;
+		alpha = score;
+		if (alpha < beta) continue;
+
+		if (quiet) {
+			if (killers[ply][0] != m) {
+				killers[ply][1] = killers[ply][0];
+				killers[ply][0] = m;
+			}
+			history[m.from][m.to] = min(history[m.from][m.to] + depth*depth, KILLER_SCORE - 1);
+		}
+		break;
+	}
+
+	// in xiangqi a side without a legal move has lost, in check or not
+	if (legal == 0) return -MATE + ply;
+
+	using Bound = TranspositionTable::Bound;
+	const Bound bound = best>=beta ?Bound::lower :best>alphaOrig ?Bound::exact :Bound::upper;
+	tt.store(board.key(), {bestMove, static_cast<std::int16_t>(scoreToTable(best, ply)), static_cast<std::int8_t>(depth), bound});
+	return best;
+}
+
+SearchResult Search::iterate(const Board &position, const History &past, const SearchLimits &limits_, const IterationCallback &onIteration) {
+	assert(past.key() == position.key());
+	board = position;
+	line = past;
+	limits = limits_;
+	start = Clock::now();
+	stopped = false;
+	nodes.store(0, std::memory_order_relaxed);
+	ttProbes = ttHits = 0;
+	for (auto &k: killers) k.fill(NO_MOVE);
+	for (auto &h: history) h.fill(0);
+
+	// helpers break ties among quiet moves differently from the main thread
+	if (helperIndex) {
+		uint64_t state = helperIndex;
+		for (auto &h: history) {
+			for (int &v: h) {
+				state = state*6364136223846793005ull + 1442695040888963407ull;
+				v = state >> 58;
+			}
+		}
+	}
+
+	SearchResult result;
+	for (int depth=1 + helperIndex%2; depth<=min(limits.depth, MAX_PLY-1); ++depth) {
+		rootBest = NO_MOVE;
+		const int score = negamax(depth, 0, -INF, INF);
+		// a partial iteration still improves on the previous one if it found a move
+		if (stopped && rootBest == NO_MOVE) break;
+
+		result.best = rootBest;
+		if (!stopped) {
+			result.score = score;
+			result.depth = depth;
+		}
+		result.nodes = totalNodes();
+		result.ttProbes = ttProbes;
+		result.ttHits = ttHits;
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (stopped) break;
+		if (onIteration) onIteration(result);
+		if (result.best == NO_MOVE || score >= MATE - MAX_PLY || score <= -MATE + MAX_PLY) break;
+	}
+
+	// stopped before any root move was searched: still a legal move, unless there is none
+	if (result.best == NO_MOVE) {
+		const MoveList moves = position.generateMoves(position.sideToMove());
+		if (!moves.empty()) result.best = moves[0];
+	}
+
+	result.nodes = nodes.load(std::memory_order_relaxed);
+	result.ttProbes = ttProbes;
+	result.ttHits = ttHits;
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return result;
+}
+
+SearchResult Search::run(const Board &position, const SearchLimits &limits_, const IterationCallback &onIteration) {
+	return run(position, History{position}, limits_, onIteration);
+}
+
+SearchResult Search::run(const Board &position, const History &past, const SearchLimits &limits_, const IterationCallback &onIteration) {
+	stopRequested.store(false, std::memory_order_relaxed);
+	for (const std::unique_ptr<Search> &h: helpers) h->stopRequested.store(false, std::memory_order_relaxed);
+
+	// the main thread alone watches the clock and the node budget
+	SearchLimits helperLimits{limits_};
+	helperLimits.movetimeMs = 0;
+	helperLimits.nodes = 0;
+
+	std::vector<SearchResult> helperResults(helpers.size());
+	std::vector<std::thread> workers;
+	for (size_t i=0; i<helpers.size(); ++i) {
+		workers.emplace_back([this, i, &position, &past, &helperLimits, &helperResults]{
+			helperResults[i] = helpers[i]->iterate(position, past, helperLimits, {});
+		});
+	}
+
+	SearchResult result{iterate(position, past, limits_, onIteration)};
+	for (const std::unique_ptr<Search> &h: helpers) h->stop();
+	for (std::thread &w: workers) w.join();
+
+	for (const SearchResult &r: helperResults) {
+		if (r.depth > result.depth && r.best != NO_MOVE) {
+			result.best = r.best;
+			result.score = r.score;
+			result.depth = r.depth;
+		}
+		result.nodes += r.nodes;
+		result.ttProbes += r.ttProbes;
+		result.ttHits += r.ttHits;
+	}
+	return result;
+}
@@ -0,0 +1,101 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Board.hpp"
+#include "History.hpp"
+#include "Move.hpp"
+#include "Tablebase.hpp"
+#include "TranspositionTable.hpp"
+
+struct SearchLimits {
+	int depth = 64;
+	std::int64_t movetimeMs = 0; // 0 for no time limit
+	std::uint64_t nodes = 0;     // 0 for no node limit
+};
+
+struct SearchResult {
+	Move best = NO_MOVE;
+	int score = 0;
+	int depth = 0;
+	std::uint64_t nodes = 0;
+	double seconds = 0;
+	std::uint64_t ttProbes = 0, ttHits = 0;
+
+	double nodesPerSecond() const { return seconds>0 ?nodes/seconds :0; }
+	double ttHitRate() const { return ttProbes>0 ?static_cast<double>(ttHits)/ttProbes :0; }
+};
+
+// Negamax alpha-beta with iterative deepening and a quiescence search on captures.
+// Moves are tried in the order: table move, captures by MVV-LVA, killers, history.
+//
+// With more than one thread the search is Lazy SMP: helper threads search the same root
+// independently, offset by one ply on odd helpers and with their history tables seeded
+// differently, and only communicate through the shared transposition table.
+class Search {
+	public:
+		static constexpr int MAX_PLY = 64;
+		static constexpr int INF = 32000;
+		static constexpr int MATE = 30000;
+		static_assert(MAX_PLY <= History::MAX_LINE, "a line must not overwrite the game it repeats");
+
+		using IterationCallback = std::function<void(const SearchResult &)>;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		TranspositionTable &tt;
+		const Tablebases *tablebases = nullptr;
+		Board board{Board::makeStandardBoard()};
+		// the game so far followed by the current line, pushed and popped with board
+		History line;
+		SearchLimits limits;
+		Clock::time_point start;
+		std::atomic<bool> stopRequested{false};
+		bool stopped = false;
+
+		// written only by the searching thread, read by the main thread for reporting
+		std::atomic<std::uint64_t> nodes{0};
+		std::uint64_t ttProbes = 0, ttHits = 0;
+		Move rootBest = NO_MOVE;
+		std::array<std::array<Move, 2>, MAX_PLY> killers;
+		std::array<std::array<int, Board::N_SQUARE>, Board::N_SQUARE> history;
+
+		int helperIndex = 0;
+		std::vector<std::unique_ptr<Search>> helpers;
+
+		void countNode() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+		std::uint64_t totalNodes() const;
+		bool checkStop();
+		void orderMoves(MoveList &moves, std::array<int, MoveList::CAPACITY> &scores, Move ttMove, int ply) const;
+		int negamax(int depth, int ply, int alpha, int beta);
+		int quiescence(int ply, int alpha, int beta);
+		SearchResult iterate(const Board &position, const History &past, const SearchLimits &limits, const IterationCallback &onIteration);
+
+	public:
+		explicit Search(TranspositionTable &tt_): tt(tt_) { }
+
+		// threads used by run(), the calling thread included; not while run() is searching
+		void setThreads(int n);
+		int threads() const { return 1 + helpers.size(); }
+		// positions below the root found in the tables are scored by them rather than searched
+		void setTablebases(const Tablebases *t);
+
+		// the best move found for the side to move of `position` within `limits`: the first
+		// legal move if stopped before depth 1 finished, NO_MOVE only if there is no legal move
+		SearchResult run(const Board &position, const SearchLimits &limits, const IterationCallback &onIteration = {});
+		// the same, with `past` ending in `position`: a line that repeats a position of the
+		// game or of itself is a draw, or lost for the side committing perpetual check or chase
+		SearchResult run(const Board &position, const History &past, const SearchLimits &limits, const IterationCallback &onIteration = {});
+		// may be called from another thread while run() is searching
+		void stop();
+};
+
+#endif
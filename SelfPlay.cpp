@@ -0,0 +1,161 @@
+#include "SelfPlay.hpp"
+#include "BinaryRecord.hpp"
+#include "History.hpp"
+#include "TranspositionTable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+using GameRecord::Result;
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace SelfPlay {
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		uint64_t splitMix(uint64_t &state) {
+			uint64_t z = state += 0x9e3779b97f4a7c15ull;
+			z = (z ^ z>>30) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ z>>27) * 0x94d049bb133111ebull;
+			return z ^ z>>31;
+		}
+
+		struct Game {
+			Board start{Board::makeStandardBoard()};
+			vector<Move> moves;
+			vector<std::int16_t> scores;
+			Result result = Result::draw;
+			bool repetition = false, moveCap = false;
+			uint64_t nodes = 0;
+		};
+
+		Result lossOf(const Team team) { return team==Team::red ?Result::blackWin :Result::redWin; }
+
+		// the start position after the random moves, retried while they end the game
+		Board openingOf(const Settings &settings, const size_t index) {
+			uint64_t state = settings.seed ^ index*0xd1b54a32d192ed03ull;
+			while (true) {
+				Board board = Board::makeStandardBoard();
+				int plies = 0;
+				for (; plies<settings.randomPlies; ++plies) {
+					const MoveList moves = board.generateMoves(board.sideToMove());
+					if (moves.empty()) break;
+					board.makeMove(moves[splitMix(state) % moves.size()]);
+				}
+				if (plies==settings.randomPlies && !board.generateMoves(board.sideToMove()).empty()) return board;
+			}
+		}
+
+		Game playGame(const Settings &settings, const size_t index, Search &search, TranspositionTable &tt) {
+			Game game;
+			game.start = openingOf(settings, index);
+			tt.clear();
+
+			Board board{game.start};
+			History history{board};
+			while (true) {
+				// in xiangqi a side without a legal move has lost, in check or not
+				if (board.generateMoves(board.sideToMove()).empty()) {
+					game.result = lossOf(board.sideToMove());
+					return game;
+				}
+				if (static_cast<int>(game.moves.size()) >= settings.maxPlies) {
+					game.moveCap = true;
+					game.result = Result::draw;
+					return game;
+				}
+
+				const SearchResult r = search.run(board, history, settings.limits);
+				game.nodes += r.nodes;
+				assert(r.best != NO_MOVE);
+				game.moves.push_back(r.best);
+				game.scores.push_back(static_cast<std::int16_t>(std::clamp(r.score, -Search::INF, Search::INF)));
+				history.push(board, board.makeMove(r.best));
+
+				if (history.repetitions() >= 2) {
+					const optional<Team> loser = history.classify(board, history.lastRepeat()).loser();
+					game.repetition = true;
+					game.result = loser.has_value() ?lossOf(*loser) :Result::draw;
+					return game;
+				}
+			}
+		}
+	}
+
+	optional<Stats> play(const Settings &settings, const char *path, std::ostream &log) {
+		assert(settings.threads > 0 && settings.limits.movetimeMs == 0);
+		assert(settings.maxPlies <= static_cast<int>(BinaryRecord::MAX_PLIES));
+
+		std::ofstream out{path, std::ios::binary | std::ios::trunc};
+		if (!out) return nullopt;
+
+		Stats stats;
+		stats.busySeconds.assign(settings.threads, 0);
+		stats.gamesPerThread.assign(settings.threads, 0);
+		const Clock::time_point start = Clock::now();
+
+		// finished games wait here until those before them are written
+		std::mutex mutex;
+		std::map<size_t, Game> finished;
+		size_t nextToWrite = 0;
+		vector<uint8_t> bytes;
+		const auto write = [&](const size_t index, Game &&game) {
+			const std::lock_guard<std::mutex> lock{mutex};
+			finished.emplace(index, std::move(game));
+			for (auto it=finished.begin(); it!=finished.end() && it->first==nextToWrite; it=finished.erase(it), ++nextToWrite) {
+				const Game &g = it->second;
+				bytes.resize(BinaryRecord::gameSize(g.moves.size(), true));
+				BinaryRecord::saveGame(g.start, g.moves.data(), g.moves.size(), g.result, bytes.data(), g.scores.data());
+				out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+
+				++stats.games;
+				stats.plies += g.moves.size();
+				stats.nodes += g.nodes;
+				++stats.results[static_cast<int>(g.result)];
+				stats.repetitions += g.repetition;
+				stats.moveCaps += g.moveCap;
+				if (stats.games%100 == 0 || stats.games == settings.games) {
+					const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+					log <<stats.games <<'/' <<settings.games <<" games, " <<static_cast<long long>(stats.games*3600/seconds) <<" games/hour" <<'\n';
+				}
+			}
+		};
+
+		std::atomic<size_t> next{0};
+		vector<std::thread> workers;
+		for (int t=0; t<settings.threads; ++t) {
+			workers.emplace_back([&, t]{
+				TranspositionTable tt{settings.hashMegabytes};
+				Search search{tt};
+				for (size_t index; (index = next.fetch_add(1)) < settings.games; ) {
+					const Clock::time_point begin = Clock::now();
+					Game game = playGame(settings, index, search, tt);
+					stats.busySeconds[t] += std::chrono::duration<double>(Clock::now() - begin).count();
+					++stats.gamesPerThread[t];
+					write(index, std::move(game));
+				}
+			});
+		}
+		for (std::thread &w: workers) w.join();
+
+		stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (!out.flush()) return nullopt;
+		return stats;
+	}
+}
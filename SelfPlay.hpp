@@ -0,0 +1,56 @@
+#ifndef SELF_PLAY_HPP
+#define SELF_PLAY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "GameRecord.hpp"
+#include "Search.hpp"
+
+// Games of the engine against itself, for tuning data. Each of `threads` workers has its
+// own Search and table and plays whole games, taken in order from a shared counter.
+//
+// A game starts from the standard position with randomPlies random legal moves, drawn from
+// a generator seeded by the settings' seed and the game's number, then searches every move
+// within `limits`, which must not include a movetime. It ends with no legal move, a loss
+// for the side to move; on the third occurrence of a position, by History::Cycle::loser();
+// or as a draw after maxPlies searched moves. The table is cleared between games, so the
+// games depend only on the settings and not on the threads or their timing.
+//
+// Games are written in order as BinaryRecord games with SCORED, starting from the position
+// after the random moves.
+namespace SelfPlay {
+	struct Settings {
+		std::size_t games = 100;
+		int threads = 1;
+		SearchLimits limits;
+		int randomPlies = 8;
+		int maxPlies = 300;
+		std::uint64_t seed = 1;
+		std::size_t hashMegabytes = 16;
+	};
+
+	struct Stats {
+		std::size_t games = 0;
+		std::uint64_t plies = 0, nodes = 0;
+		std::array<std::size_t, 4> results{};   // by GameRecord::Result
+		std::size_t repetitions = 0, moveCaps = 0;
+		double seconds = 0;
+		std::vector<double> busySeconds;         // per thread, in games
+		std::vector<std::size_t> gamesPerThread;
+
+		std::size_t count(GameRecord::Result r) const { return results[static_cast<int>(r)]; }
+		double gamesPerHour() const { return seconds>0 ?games * 3600 / seconds :0; }
+		// the share of the run the thread spent playing
+		double utilization(std::size_t thread) const { return seconds>0 ?busySeconds[thread] / seconds :0; }
+	};
+
+	// plays the games into the file at `path`, with progress on `log`; nullopt if it cannot be written
+	std::optional<Stats> play(const Settings &settings, const char *path, std::ostream &log);
+}
+
+#endif
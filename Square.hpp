@@ -0,0 +1,75 @@
+#ifndef SQUARE_HPP
+#define SQUARE_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "Team.hpp"
+#include "Vector2d.hpp"
+
+// Squares as indices 0..89, x*9+y as Board::indexOf(), and a padded mailbox to step between
+// them: everything up to two rows or columns off the board reads NO_SQUARE, so a Ma, Xiang
+// or one-step move needs a sentinel comparison rather than the four of inBound().
+namespace SquareNS {
+	constexpr int N_COL = 9;
+	constexpr int N_ROW = 10;
+	constexpr int N_SQUARE = N_COL * N_ROW;
+	constexpr std::uint8_t NO_SQUARE = 0xff;
+
+	constexpr bool inBound(Vector2d p) { return 0<=p.x && p.x<N_ROW && 0<=p.y && p.y<N_COL; }
+	constexpr int indexOf(Vector2d p) { return p.x*N_COL + p.y; }
+	constexpr Vector2d vectorOf(int square) { return {square/N_COL, square%N_COL}; }
+
+	// the square as seen from `team`'s side; black sees the board as it is
+	constexpr Vector2d toTeam(Team team, Vector2d p) { return team==Team::black ?p :Vector2d{N_ROW-1-p.x, N_COL-1-p.y}; }
+	// on the team's side of the river
+	constexpr bool inTeam(Team team, Vector2d p) { return toTeam(team, p).x < N_ROW/2; }
+	// in the team's palace
+	constexpr bool inBase(Team team, Vector2d p) {
+		const Vector2d t = toTeam(team, p);
+		return t.x<=2 && 3<=t.y && t.y<=5;
+	}
+
+	// Board rows of WIDTH cells: the nine squares, then two padding cells that also pad the
+	// start of the next row; two rows of padding above and below.
+	namespace Mailbox {
+		constexpr int MARGIN = 2;
+		constexpr int WIDTH = N_COL + MARGIN;
+
+		constexpr int of(int square) { return (square/N_COL + MARGIN)*WIDTH + square%N_COL + MARGIN; }
+		constexpr int offset(Vector2d d) { return d.x*WIDTH + d.y; }
+		constexpr int SIZE = of(N_SQUARE-1) + offset({MARGIN, MARGIN}) + 1;
+		static_assert(of(0) + offset({-MARGIN, -MARGIN}) >= 0);
+
+		// the square in every cell, NO_SQUARE in the padding
+		constexpr std::array<std::uint8_t, SIZE> squares = []{
+			std::array<std::uint8_t, SIZE> result{};
+			for (std::uint8_t &s: result) s = NO_SQUARE;
+			for (int i=0; i<N_SQUARE; ++i) result[of(i)] = i;
+			return result;
+		}();
+	}
+
+	// the square `d` away, or NO_SQUARE off the board; |d.x| and |d.y| are at most 2
+	constexpr int step(int square, Vector2d d) {
+		return Mailbox::squares[Mailbox::of(square) + Mailbox::offset(d)];
+	}
+
+	static_assert(step(indexOf({0,0}), {-2,-2})==NO_SQUARE && step(indexOf({9,8}), {2,2})==NO_SQUARE);
+	static_assert(step(indexOf({3,8}), {0,1})==NO_SQUARE && step(indexOf({3,0}), {1,-2})==NO_SQUARE);
+	static_assert(step(indexOf({4,4}), {-2,1})==indexOf({2,5}));
+
+	constexpr std::array<Vector2d, 4> orthogonal{{{1,0}, {-1,0}, {0,1}, {0,-1}}};
+	constexpr std::array<Vector2d, 4> diagonal{{{1,1}, {1,-1}, {-1,1}, {-1,-1}}};
+
+	// step() of every square in the orthogonal directions
+	constexpr std::array<std::array<std::uint8_t, 4>, N_SQUARE> neighbours = []{
+		std::array<std::array<std::uint8_t, 4>, N_SQUARE> result{};
+		for (int i=0; i<N_SQUARE; ++i) {
+			for (int j=0; j<4; ++j) result[i][j] = step(i, orthogonal[j]);
+		}
+		return result;
+	}();
+}
+
+#endif
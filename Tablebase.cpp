@@ -0,0 +1,487 @@
+#include "Tablebase.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+
+using PieceNS::Kind;
+using PieceNS::N_KIND;
+using std::array;
+using std::nullopt;
+using std::optional;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace {
+	// FEN letters in PieceNS::Kind order
+	constexpr string_view LETTERS{"KABNRCP"};
+
+	// A value is a byte: UNKNOWN for a draw, INVALID for a placement that is not a legal
+	// position, BEYOND for a position the analysis left undecided when it stopped at MAX_DTM,
+	// otherwise 1 + the distance to mate in plies, odd distances being wins.
+	constexpr uint8_t UNKNOWN = 0;
+	constexpr uint8_t BEYOND = 0xfe;
+	constexpr uint8_t INVALID = 0xff;
+	constexpr int MAX_DTM = 0xfc;
+
+	bool isMate(const uint8_t v) { return v!=UNKNOWN && v!=BEYOND && v!=INVALID; }
+	bool isWin(const uint8_t v) { return isMate(v) && (v-1)%2==1; }
+	bool isLoss(const uint8_t v) { return isMate(v) && (v-1)%2==0; }
+
+	// a child of a position: its index in the same table, or with IMMEDIATE set, the final
+	// value of a position of another material reached by a capture
+	constexpr uint32_t IMMEDIATE = 0x80000000u;
+	constexpr uint64_t MAX_POSITIONS = IMMEDIATE;
+
+	// positions handed to a thread at a time
+	constexpr uint64_t CHUNK = 1 << 14;
+
+	// the squares each team*N_KIND + kind may stand on, in order, and the place of each
+	// square in that order
+	struct Squares {
+		array<uint8_t, Board::N_SQUARE> list;
+		int size = 0;
+		array<std::int8_t, Board::N_SQUARE> ordinal;
+	};
+
+	const array<Squares, 2*N_KIND> &allowed() {
+		static const array<Squares, 2*N_KIND> table = []{
+			array<Squares, 2*N_KIND> result;
+			for (int i=0; i<2*N_KIND; ++i) {
+				const Bitboard bits = Board::allowedSquares(static_cast<Kind>(i%N_KIND), static_cast<Team>(i/N_KIND));
+				result[i].ordinal.fill(-1);
+				for (int sq=0; sq<Board::N_SQUARE; ++sq) {
+					if (!BitboardNS::test(bits, sq)) continue;
+					result[i].ordinal[sq] = result[i].size;
+					result[i].list[result[i].size++] = sq;
+				}
+			}
+			return result;
+		}();
+		return table;
+	}
+
+	// placements of the pieces of one side to move
+	uint64_t placements(const Material &material) {
+		uint64_t result = 1;
+		for (int i=0; i<2*N_KIND; ++i) {
+			for (int n=material.count(static_cast<Kind>(i%N_KIND), static_cast<Team>(i/N_KIND)); n>0; --n) result *= allowed()[i].size;
+		}
+		return result;
+	}
+
+	// The side to move, then the squares of the pieces of each team*N_KIND + kind in square
+	// order as digits of a mixed-radix number; nullopt if a piece is off its allowed squares.
+	optional<uint64_t> indexOf(const Board &board, const uint64_t perSide) {
+		uint64_t placement = 0;
+		for (int i=0; i<2*N_KIND; ++i) {
+			const Squares &s = allowed()[i];
+			for (Bitboard bits=board.piecesOf(static_cast<Kind>(i%N_KIND), static_cast<Team>(i/N_KIND)); bits; ) {
+				const int ordinal = s.ordinal[BitboardNS::popLowest(bits)];
+				if (ordinal < 0) return nullopt;
+				placement = placement*s.size + ordinal;
+			}
+		}
+		return (board.sideToMove()==Team::black ?perSide :0) + placement;
+	}
+
+	// the position of `index`, nullopt for placements that are not legal positions; pieces of
+	// one kind must be in square order so that every position has one index
+	optional<Board> positionOf(const Material &material, const uint64_t index, const uint64_t perSide) {
+		array<uint8_t, Board::PACKED_SIZE> packed;
+		packed.fill(Board::NO_SQUARE);
+		uint64_t placement = index % perSide;
+		for (int i=2*N_KIND-1; i>=0; --i) {
+			const Kind kind = static_cast<Kind>(i%N_KIND);
+			const Team team = static_cast<Team>(i/N_KIND);
+			const Squares &s = allowed()[i];
+			const int first = static_cast<int>(team)*PieceNS::N_SLOT_TEAM + PieceNS::firstSlotOfKind[static_cast<int>(kind)];
+			for (int n=material.count(kind, team)-1; n>=0; --n) {
+				packed[first+n] = s.list[placement % s.size];
+				placement /= s.size;
+				if (n+1<material.count(kind, team) && packed[first+n]>=packed[first+n+1]) return nullopt;
+			}
+		}
+		if (index >= perSide) packed[0] |= 0x80;
+		return Board::unpack(packed.data());
+	}
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t blockSize;
+		uint64_t positions;
+		uint64_t materialKey;
+		char name[16];
+	};
+
+	constexpr char MAGIC[8] = {'C', 'C', 'H', 'S', 'T', 'B', '\0', '\0'};
+	constexpr uint32_t VERSION = 2;
+	constexpr string_view EXTENSION{".cctb"};
+
+	static_assert(sizeof(Header) == 48, "the file layout depends on it");
+
+	// Blocks as (run length - 1, value) byte pairs, or raw where that is not shorter; the
+	// offsets, one per block plus the end, say which.
+	void compress(const vector<uint8_t> &values, vector<uint32_t> &offsets, vector<uint8_t> &data) {
+		for (size_t begin=0; begin<values.size(); begin+=Tablebase::BLOCK_SIZE) {
+			offsets.push_back(data.size());
+			const size_t end = std::min(values.size(), begin + Tablebase::BLOCK_SIZE);
+			const size_t start = data.size();
+			for (size_t i=begin; i<end && data.size()-start<end-begin; ) {
+				size_t run = 1;
+				while (i+run<end && run<256 && values[i+run]==values[i]) ++run;
+				data.push_back(run - 1);
+				data.push_back(values[i]);
+				i += run;
+			}
+			if (data.size()-start >= end-begin) {
+				data.resize(start);
+				data.insert(data.end(), values.begin()+begin, values.begin()+end);
+			}
+		}
+		offsets.push_back(data.size());
+	}
+
+	// Retrograde analysis by iteration over the distance to mate: a position is won in d
+	// plies if a move reaches a position lost in d-1, and lost in d if every move reaches a
+	// position won in at most d-1. The moves of every position are generated once.
+	class Generator {
+		private:
+			const char *directory;
+			ThreadPool pool;
+			std::ostream &log;
+			Tablebase::GenerateStats &stats;
+			std::map<uint64_t, vector<uint8_t>> solved;
+
+			vector<uint8_t> compute(const Material &material);
+			bool write(const Material &material, const vector<uint8_t> &values);
+
+		public:
+			Generator(const char *directory_, int threads, std::ostream &log_, Tablebase::GenerateStats &stats_)
+				: directory(directory_), pool(threads), log(log_), stats(stats_) { }
+
+			bool solve(const Material &material);
+	};
+
+	bool Generator::solve(const Material &material) {
+		if (solved.count(material.key())) return true;
+		for (int i=0; i<2*N_KIND; ++i) {
+			const Kind kind = static_cast<Kind>(i%N_KIND);
+			const Team team = static_cast<Team>(i/N_KIND);
+			if (kind!=Kind::jiang && material.count(kind, team)>0 && !solve(material.without(kind, team))) return false;
+		}
+
+		if (2*placements(material) > MAX_POSITIONS) {
+			log <<material.name() <<": too many positions" <<'\n';
+			return false;
+		}
+		const vector<uint8_t> values = compute(material);
+		if (!write(material, values)) return false;
+		solved.emplace(material.key(), values);
+		return true;
+	}
+
+	vector<uint8_t> Generator::compute(const Material &material) {
+		const auto begin = std::chrono::steady_clock::now();
+		const uint64_t perSide = placements(material);
+		const uint64_t total = 2*perSide;
+		const size_t nChunks = (total + CHUNK - 1) / CHUNK;
+		vector<uint8_t> values(total, INVALID);
+
+		// children of the positions of each chunk, with where those of each position end
+		vector<vector<uint32_t>> children(nChunks), ends(nChunks);
+		vector<int> longestImmediate(nChunks, 0);
+		vector<char> beyondImmediate(nChunks, false);
+		for (size_t c=0; c<nChunks; ++c) {
+			pool.submit([&, c] {
+				for (uint64_t index=c*CHUNK; index<std::min(total, (c+1)*CHUNK); ++index) {
+					const optional<Board> board = positionOf(material, index, perSide);
+					if (board.has_value()) {
+						const Team us = board->sideToMove();
+						values[index] = 1; // lost unless a legal move turns up
+						for (const Move m: board->generatePseudoLegalMoves(us)) {
+							const Board::PieceId captured = board->idAt(Board::vectorOf(m.to));
+							Board child = *board;
+							child.makeMove(m);
+							if (child.isInCheck(us)) continue;
+
+							values[index] = UNKNOWN;
+							if (captured == Board::NO_PIECE) {
+								children[c].push_back(*indexOf(child, perSide));
+								continue;
+							}
+
+							const Material rest = material.without(PieceNS::kindOf(captured), PieceNS::teamOf(captured));
+							const vector<uint8_t> &table = solved.at(rest.key());
+							const uint8_t v = table[*indexOf(child, placements(rest))];
+							if (isMate(v)) longestImmediate[c] = std::max(longestImmediate[c], v-1);
+							beyondImmediate[c] = beyondImmediate[c] || v==BEYOND;
+							children[c].push_back(IMMEDIATE | v);
+						}
+					}
+					ends[c].push_back(children[c].size());
+				}
+			});
+		}
+		pool.wait();
+		const int longest = *std::max_element(longestImmediate.begin(), longestImmediate.end());
+
+		vector<vector<uint64_t>> updates(nChunks);
+		int quiet = 0, d = 1;
+		for (; d<=MAX_DTM && (quiet<2 || d<=longest+1); ++d) {
+			for (size_t c=0; c<nChunks; ++c) {
+				pool.submit([&, c, d] {
+					const uint64_t first = c*CHUNK;
+					for (uint64_t index=first; index<std::min(total, (c+1)*CHUNK); ++index) {
+						if (values[index] != UNKNOWN) continue;
+
+						const uint32_t *child = children[c].data() + (index==first ?0 :ends[c][index-first-1]);
+						const uint32_t *end = children[c].data() + ends[c][index-first];
+						bool found = d%2==0;
+						for (; child!=end; ++child) {
+							const uint8_t v = *child & IMMEDIATE ?*child & 0xff :values[*child];
+							// a value of this iteration is not visible yet, as updates are applied after it
+							const bool settled = isMate(v) && v-1<=d-1;
+							if (d%2==1 && settled && isLoss(v)) {
+								found = true;
+								break;
+							}
+							if (d%2==0 && !(settled && isWin(v))) {
+								found = false;
+								break;
+							}
+						}
+						if (found) updates[c].push_back(index);
+					}
+				});
+			}
+			pool.wait();
+
+			size_t changed = 0;
+			for (vector<uint64_t> &u: updates) {
+				for (uint64_t index: u) values[index] = d + 1;
+				changed += u.size();
+				u.clear();
+			}
+			quiet = changed ?0 :quiet + 1;
+			if (changed) stats.longestMate = std::max(stats.longestMate, d);
+		}
+
+		// stopped at MAX_DTM, or reaching undecided positions of another table: what is left
+		// may still be a mate, so it is not given out as a draw
+		const bool stopped = quiet<2 || d<=longest+1;
+		if (stopped || std::find(beyondImmediate.begin(), beyondImmediate.end(), true) != beyondImmediate.end()) {
+			std::replace(values.begin(), values.end(), UNKNOWN, BEYOND);
+		}
+
+		uint64_t wins = 0, losses = 0, draws = 0, undecided = 0;
+		for (const uint8_t v: values) {
+			wins += isWin(v);
+			losses += isLoss(v);
+			draws += v==UNKNOWN;
+			undecided += v==BEYOND;
+		}
+		stats.positions += wins + losses + draws + undecided;
+		stats.wins += wins;
+		stats.losses += losses;
+		stats.draws += draws;
+		stats.undecided += undecided;
+		log <<material.name() <<": " <<wins+losses+draws+undecided <<" positions, " <<wins <<" won, " <<losses <<" lost, " <<draws
+			<<" drawn, " <<undecided <<" undecided in " <<std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() <<" s" <<'\n';
+		return values;
+	}
+
+	bool Generator::write(const Material &material, const vector<uint8_t> &values) {
+		vector<uint32_t> offsets;
+		vector<uint8_t> data;
+		compress(values, offsets, data);
+
+		Header header{};
+		std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+		header.version = VERSION;
+		header.blockSize = Tablebase::BLOCK_SIZE;
+		header.positions = values.size();
+		header.materialKey = material.key();
+		const string name = material.name();
+		std::memcpy(header.name, name.data(), std::min(name.size(), sizeof header.name - 1));
+
+		const string path = Tablebase::path(directory, material);
+		std::ofstream out{path, std::ios::binary | std::ios::trunc};
+		out.write(reinterpret_cast<const char *>(&header), sizeof header);
+		out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+		out.write(reinterpret_cast<const char *>(data.data()), data.size());
+		out.close();
+		if (!out) {
+			log <<"cannot write " <<path <<'\n';
+			return false;
+		}
+
+		stats.tables.push_back(path);
+		return true;
+	}
+}
+
+optional<Material> Material::parse(const string_view name) {
+	const size_t v = name.find('v');
+	if (v==string_view::npos || name.find('v', v+1)!=string_view::npos) return nullopt;
+
+	Material m;
+	for (const Team team: {Team::red, Team::black}) {
+		const string_view side = team==Team::red ?name.substr(0, v) :name.substr(v+1);
+		for (const char c: side) {
+			const size_t kind = LETTERS.find(c>='a' && c<='z' ?c - 'a' + 'A' :c);
+			if (kind == string_view::npos) return nullopt;
+			const int max = PieceNS::firstSlotOfKind[kind+1] - PieceNS::firstSlotOfKind[kind];
+			if (++m.counts[static_cast<int>(team)*N_KIND + kind] > max) return nullopt;
+		}
+		if (m.count(Kind::jiang, team) != 1) return nullopt;
+	}
+	return m;
+}
+
+Material Material::of(const Board &board) {
+	Material m;
+	for (int i=0; i<2*N_KIND; ++i) m.counts[i] = BitboardNS::popCount(board.piecesOf(static_cast<Kind>(i%N_KIND), static_cast<Team>(i/N_KIND)));
+	return m;
+}
+
+int Material::pieces() const {
+	int result = 0;
+	for (const uint8_t c: counts) result += c;
+	return result;
+}
+
+string Material::name() const {
+	string result;
+	for (const Team team: {Team::red, Team::black}) {
+		if (team == Team::black) result += 'v';
+		for (int k=0; k<N_KIND; ++k) result.append(count(static_cast<Kind>(k), team), LETTERS[k]);
+	}
+	return result;
+}
+
+uint64_t Material::key() const {
+	uint64_t result = 0;
+	for (const uint8_t c: counts) result = result << 4 | c;
+	return result;
+}
+
+Material Material::without(const Kind kind, const Team team) const {
+	Material m{*this};
+	--m.counts[static_cast<int>(team)*N_KIND + static_cast<int>(kind)];
+	return m;
+}
+
+string Tablebase::path(const char *directory, const Material &material) {
+	return string(directory) + "/" + material.name() + string(EXTENSION);
+}
+
+optional<Tablebase::GenerateStats> Tablebase::generate(const Material &material, const char *directory, const int threads, std::ostream &log) {
+	const auto begin = std::chrono::steady_clock::now();
+	GenerateStats stats;
+	Generator generator{directory, threads, log, stats};
+	if (!generator.solve(material)) return nullopt;
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return stats;
+}
+
+optional<Tablebase> Tablebase::open(const char *path) {
+	optional<MappedFile> file = MappedFile::open(path);
+	if (!file.has_value() || file->size() < sizeof(Header)) return nullopt;
+
+	Header header;
+	std::memcpy(&header, file->data(), sizeof header);
+	if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) || header.version!=VERSION || header.blockSize!=BLOCK_SIZE) return nullopt;
+	header.name[sizeof header.name - 1] = '\0';
+	const optional<Material> material = Material::parse(header.name);
+	if (!material.has_value() || material->key()!=header.materialKey || header.positions!=2*placements(*material)) return nullopt;
+
+	const size_t blocks = (header.positions + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const size_t dataStart = sizeof(Header) + (blocks+1)*sizeof(uint32_t);
+	if (file->size() < dataStart) return nullopt;
+	// every block within the data, in order, and no longer than its values raw
+	const uint32_t *offsets = reinterpret_cast<const uint32_t *>(file->data() + sizeof(Header));
+	if (offsets[0]!=0 || offsets[blocks]!=file->size() - dataStart) return nullopt;
+	for (size_t b=0; b<blocks; ++b) {
+		const uint64_t rawSize = std::min<uint64_t>(BLOCK_SIZE, header.positions - b*BLOCK_SIZE);
+		if (offsets[b] > offsets[b+1] || offsets[b+1] - offsets[b] > rawSize) return nullopt;
+	}
+
+	// probes jump around the file, so read-ahead would only waste the page cache
+	file->adviseRandom();
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(file->data() + dataStart);
+	return Tablebase{std::move(*file), *material, header.positions, offsets, data};
+}
+
+optional<Tablebase::Probe> Tablebase::probe(const Board &board) const {
+	if (Material::of(board) != material_) return nullopt;
+	return lookup(board);
+}
+
+optional<Tablebase::Probe> Tablebase::lookup(const Board &board) const {
+	const optional<uint64_t> index = indexOf(board, positions/2);
+	if (!index.has_value()) return nullopt;
+
+	const uint64_t block = *index / BLOCK_SIZE;
+	const size_t within = *index % BLOCK_SIZE;
+	const uint8_t *p = data + blockOffsets[block], *end = data + blockOffsets[block+1];
+	const size_t rawSize = std::min<uint64_t>(BLOCK_SIZE, positions - block*BLOCK_SIZE);
+	uint8_t v;
+	if (static_cast<size_t>(end - p) == rawSize) {
+		v = p[within];
+	} else {
+		// a run past the end of the block is only in a corrupt file
+		for (size_t skipped=0; ; p+=2) {
+			if (end - p < 2) return nullopt;
+			skipped += p[0] + 1;
+			if (skipped > within) break;
+		}
+		v = p[1];
+	}
+
+	if (v==INVALID || v==BEYOND) return nullopt;
+	if (v == UNKNOWN) return Probe{Wdl::draw, 0};
+	return Probe{isWin(v) ?Wdl::win :Wdl::loss, v-1};
+}
+
+size_t Tablebases::load(const char *directory) {
+	DIR *dir = opendir(directory);
+	if (!dir) return 0;
+	while (const dirent *entry = readdir(dir)) {
+		const string_view name{entry->d_name};
+		if (name.size()<=EXTENSION.size() || name.substr(name.size()-EXTENSION.size())!=EXTENSION) continue;
+		if (optional<Tablebase> t = Tablebase::open((string(directory) + "/" + string(name)).c_str())) {
+			maxPieces = std::max(maxPieces, t->material().pieces());
+			tables.push_back(std::move(*t));
+		}
+	}
+	closedir(dir);
+	return tables.size();
+}
+
+optional<Tablebase::Probe> Tablebases::probe(const Board &board) const {
+	if (BitboardNS::popCount(board.occupancy()) > maxPieces) return nullopt;
+	const Material material = Material::of(board);
+	for (const Tablebase &t: tables) {
+		if (t.material() == material) return t.lookup(board);
+	}
+	return nullopt;
+}
@@ -0,0 +1,108 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Board.hpp"
+#include "MappedFile.hpp"
+#include "Piece.hpp"
+
+// The pieces of both sides, named by their FEN letters with red first, e.g. "KRvKAA" for
+// Ju against two Shi. Both sides always have their Jiang.
+class Material {
+	private:
+		std::array<std::uint8_t, 2*PieceNS::N_KIND> counts{};
+
+	public:
+		static std::optional<Material> parse(std::string_view name);
+		static Material of(const Board &board);
+
+		int count(PieceNS::Kind kind, Team team) const { return counts[static_cast<int>(team)*PieceNS::N_KIND + static_cast<int>(kind)]; }
+		int pieces() const;
+		std::string name() const;
+		// the same for equal material, computed without allocating
+		std::uint64_t key() const;
+		// the material after a piece of the kind is captured
+		Material without(PieceNS::Kind kind, Team team) const;
+
+		bool operator ==(const Material &other) const { return counts == other.counts; }
+		bool operator !=(const Material &other) const { return counts != other.counts; }
+};
+
+// Distance to mate for every position of one material, generated by retrograde analysis and
+// read through a read-only mapping. A position is indexed by the side to move and the square
+// of every piece among the squares its kind may stand on, so Shi stay in the palace and so on.
+// Values are kept in blocks of BLOCK_SIZE run-length encoded bytes, making a probe decode at
+// most one block. Repetition rules are not modelled: a position no side can force to mate is a
+// draw, and a side without a legal move has lost. The analysis stops at mates of 252 plies;
+// positions it leaves undecided then are stored as such and not found by a probe.
+class Tablebase {
+	public:
+		static constexpr std::size_t BLOCK_SIZE = 256;
+
+		enum class Wdl { loss, draw, win };
+
+		// for the side to move; dtm is in plies, 0 for a draw or when mated
+		struct Probe {
+			Wdl wdl;
+			int dtm;
+		};
+
+		struct GenerateStats {
+			std::vector<std::string> tables; // every table written, the requested one last
+			std::uint64_t positions = 0, wins = 0, losses = 0, draws = 0;
+			std::uint64_t undecided = 0; // left open by an analysis that stopped at its longest mate
+			int longestMate = 0;
+			double seconds = 0;
+		};
+
+	private:
+		MappedFile file;
+		Material material_;
+		std::uint64_t positions;
+		const std::uint32_t *blockOffsets;
+		const std::uint8_t *data;
+
+		friend class Tablebases;
+		// probe() for a board known to have the material of the table
+		std::optional<Probe> lookup(const Board &board) const;
+
+		Tablebase(MappedFile file_, Material material, std::uint64_t positions_, const std::uint32_t *blockOffsets_, const std::uint8_t *data_)
+			: file(std::move(file_)), material_(material), positions(positions_), blockOffsets(blockOffsets_), data(data_) { }
+
+	public:
+		// nullopt if the file cannot be read or is not a tablebase
+		static std::optional<Tablebase> open(const char *path);
+		// the file name of the table of `material` in `directory`
+		static std::string path(const char *directory, const Material &material);
+		// Writes the table of `material` to `directory`, with the tables of every material a
+		// capture leads to; nullopt if a file cannot be written or there are too many positions.
+		static std::optional<GenerateStats> generate(const Material &material, const char *directory, int threads, std::ostream &log);
+
+		const Material &material() const { return material_; }
+		// nullopt if the board has other material than the table or the position is undecided
+		std::optional<Probe> probe(const Board &board) const;
+};
+
+// the tables of a directory, found by the material of a board
+class Tablebases {
+	private:
+		std::vector<Tablebase> tables;
+		int maxPieces = 0;
+
+	public:
+		// opens every table in `directory`; returns how many
+		std::size_t load(const char *directory);
+		std::size_t size() const { return tables.size(); }
+		// nullopt if there is no table for the material of the board
+		std::optional<Tablebase::Probe> probe(const Board &board) const;
+};
+
+#endif
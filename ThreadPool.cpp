@@ -0,0 +1,83 @@
+#include "ThreadPool.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+using std::lock_guard;
+using std::mutex;
+using std::size_t;
+using std::unique_lock;
+
+ThreadPool::ThreadPool(const int n) {
+	assert(n >= 1);
+	for (int i=0; i<n; ++i) queues.push_back(std::make_unique<Queue>());
+	for (int i=0; i<n; ++i) threads.emplace_back([this, i]{ work(i); });
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> lock{idleMutex};
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &t: threads) t.join();
+}
+
+void ThreadPool::submit(Task task) {
+	Queue &q = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+	unfinished.fetch_add(1);
+	{
+		lock_guard<mutex> lock{q.mutex};
+		q.tasks.push_back(std::move(task));
+	}
+	queued.fetch_add(1);
+
+	// taking the lock orders this against a worker checking `queued` before it sleeps
+	lock_guard<mutex> lock{idleMutex};
+	wake.notify_one();
+}
+
+bool ThreadPool::tryTake(const size_t self, Task &task) {
+	for (size_t k=0; k<queues.size(); ++k) {
+		Queue &q = *queues[(self + k) % queues.size()];
+		lock_guard<mutex> lock{q.mutex};
+		if (q.tasks.empty()) continue;
+
+		if (k == 0) {
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		} else {
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+		queued.fetch_sub(1);
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::work(const size_t self) {
+	Task task;
+	while (true) {
+		if (tryTake(self, task)) {
+			task();
+			task = nullptr;
+			if (unfinished.fetch_sub(1) == 1) {
+				lock_guard<mutex> lock{idleMutex};
+				done.notify_all();
+			}
+			continue;
+		}
+
+		unique_lock<mutex> lock{idleMutex};
+		wake.wait(lock, [this]{ return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0) return;
+	}
+}
+
+void ThreadPool::wait() {
+	unique_lock<mutex> lock{idleMutex};
+	done.wait(lock, [this]{ return unfinished.load() == 0; });
+}
@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker takes its newest
+// task first and, when its deque is empty, steals the oldest task of another worker,
+// so uneven tasks spread out without a single shared queue.
+class ThreadPool {
+	public:
+		using Task = std::function<void()>;
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+
+		std::atomic<std::size_t> queued{0};     // in some deque
+		std::atomic<std::size_t> unfinished{0}; // submitted and not yet done
+		std::atomic<std::size_t> nextQueue{0};
+		std::mutex idleMutex;
+		std::condition_variable wake, done;
+		bool stopping = false;
+
+		bool tryTake(std::size_t self, Task &task);
+		void work(std::size_t self);
+
+	public:
+		explicit ThreadPool(int threads);
+		~ThreadPool();
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator =(const ThreadPool &) = delete;
+
+		int size() const { return threads.size(); }
+		void submit(Task task);
+		// blocks until every task submitted so far has finished
+		void wait();
+};
+
+#endif
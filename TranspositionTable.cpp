@@ -0,0 +1,70 @@
+#include "TranspositionTable.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+using std::optional;
+using std::nullopt;
+using std::size_t;
+using std::uint64_t;
+
+namespace {
+	constexpr auto relaxed = std::memory_order_relaxed;
+}
+
+TranspositionTable::TranspositionTable(const size_t megabytes) {
+	size_t n = 1;
+	while (2*n*sizeof(Slot) <= megabytes<<20) n *= 2;
+	slots = std::make_unique<Slot[]>(n);
+	mask = n - 1;
+	clear();
+}
+
+void TranspositionTable::clear() {
+	for (size_t i=0; i<=mask; ++i) {
+		slots[i].check.store(0, relaxed);
+		slots[i].data.store(0, relaxed);
+	}
+}
+
+uint64_t TranspositionTable::pack(const Entry e) {
+	return uint64_t{e.move.from}
+		| uint64_t{e.move.to} << 8
+		| uint64_t{static_cast<std::uint16_t>(e.score)} << 16
+		| uint64_t{static_cast<std::uint8_t>(e.depth)} << 32
+		| uint64_t{static_cast<std::uint8_t>(e.bound)} << 40;
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(const uint64_t d) {
+	return Entry{
+		Move{static_cast<std::uint8_t>(d), static_cast<std::uint8_t>(d >> 8)},
+		static_cast<std::int16_t>(d >> 16),
+		static_cast<std::int8_t>(d >> 32),
+		static_cast<Bound>(d >> 40 & 3),
+	};
+}
+
+optional<TranspositionTable::Entry> TranspositionTable::probe(const uint64_t key) const {
+	const Slot &slot = slots[key & mask];
+	const uint64_t data = slot.data.load(relaxed);
+	if ((slot.check.load(relaxed) ^ data) != key) return nullopt;
+
+	const Entry e = unpack(data);
+	if (e.bound == Bound::none) return nullopt;
+	return e;
+}
+
+void TranspositionTable::store(const uint64_t key, const Entry entry) {
+	assert(entry.bound != Bound::none);
+
+	Slot &slot = slots[key & mask];
+	const uint64_t oldData = slot.data.load(relaxed);
+	if ((slot.check.load(relaxed) ^ oldData) == key && unpack(oldData).depth > entry.depth) return;
+
+	const uint64_t data = pack(entry);
+	slot.check.store(key ^ data, relaxed);
+	slot.data.store(data, relaxed);
+}
@@ -0,0 +1,49 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "Move.hpp"
+
+// Fixed-size table of search results shared by any number of threads without locking.
+// Every slot stores key^data next to data; a reader that races a writer sees a pair
+// that no longer XORs back to its key and treats the slot as empty.
+class TranspositionTable {
+	public:
+		enum class Bound : std::uint8_t { none, upper, lower, exact };
+
+		struct Entry {
+			Move move;
+			std::int16_t score;
+			std::int8_t depth;
+			Bound bound;
+		};
+
+	private:
+		struct Slot {
+			std::atomic<std::uint64_t> check;
+			std::atomic<std::uint64_t> data;
+		};
+
+		std::unique_ptr<Slot[]> slots;
+		std::size_t mask;
+
+		static std::uint64_t pack(Entry);
+		static Entry unpack(std::uint64_t);
+
+	public:
+		// rounded down to a power of two number of slots
+		explicit TranspositionTable(std::size_t megabytes);
+
+		std::size_t size() const { return mask + 1; }
+		void clear();
+		std::optional<Entry> probe(std::uint64_t key) const;
+		// keeps a deeper result for the same position, otherwise overwrites
+		void store(std::uint64_t key, Entry entry);
+};
+
+#endif
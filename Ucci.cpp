@@ -0,0 +1,202 @@
+#include "Ucci.hpp"
+#include "Notation.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+
+using std::optional;
+using std::nullopt;
+using std::string;
+using std::string_view;
+
+namespace {
+	// the next word of `s`, which is advanced past it; empty at the end
+	string_view nextToken(string_view &s) {
+		const size_t begin = std::min(s.find_first_not_of(" \t\r"), s.size());
+		const size_t end = std::min(s.find_first_of(" \t\r", begin), s.size());
+		const string_view result = s.substr(begin, end - begin);
+		s.remove_prefix(end);
+		return result;
+	}
+
+	template <typename T> optional<T> parseNumber(const string_view s) {
+		T result;
+		const auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), result);
+		if (error!=std::errc{} || end!=s.data() + s.size()) return nullopt;
+		return result;
+	}
+
+	// a move of the side to move that Board accepts, otherwise nullopt
+	optional<Move> parseMove(const Board &board, const string_view s) {
+		const optional<Move> m = Notation::parseIccs(s);
+		if (!m.has_value()) return nullopt;
+		const Vector2d from = Board::vectorOf(m->from), to = Board::vectorOf(m->to);
+		if (!board.pieceExist(from) || board.pieceAt(from)->team!=board.sideToMove()) return nullopt;
+		if (!board.isMoveable(from, to) || !board.isLegal(*m)) return nullopt;
+		return m;
+	}
+
+	string iccs(const Move m) {
+		const std::array<char, 4> s = Notation::formatIccs(m);
+		return string(s.begin(), s.end());
+	}
+}
+
+Ucci::Ucci(std::ostream &out_, const Options &options_): out(out_), options(options_) {
+	makeSearch();
+}
+
+Ucci::~Ucci() {
+	halt();
+}
+
+void Ucci::send(const string_view line) {
+	const std::lock_guard<std::mutex> lock{outMutex};
+	out <<line <<std::endl;
+}
+
+void Ucci::halt() {
+	stopPending.store(true);
+	if (search) search->stop();
+	wait();
+}
+
+void Ucci::makeSearch() {
+	halt();
+	search.reset();
+	tt = std::make_unique<TranspositionTable>(options.hashMegabytes);
+	search = std::make_unique<Search>(*tt);
+	search->setThreads(options.threads);
+	search->setTablebases(options.tablebases);
+}
+
+void Ucci::wait() {
+	if (searcher.joinable()) searcher.join();
+}
+
+void Ucci::setOption(string_view args) {
+	const string_view name = nextToken(args);
+	if (name == "newgame") {
+		halt();
+		tt->clear();
+		return;
+	}
+
+	const optional<int> value = parseNumber<int>(nextToken(args));
+	if (!value.has_value() || *value <= 0) return;
+	if (name == "hashsize") {
+		options.hashMegabytes = *value;
+		makeSearch();
+	} else if (name == "threads") {
+		halt();
+		options.threads = *value;
+		search->setThreads(*value);
+	}
+}
+
+void Ucci::position(string_view args) {
+	halt();
+
+	const string_view kind = nextToken(args);
+	optional<Board> start;
+	if (kind == "startpos") {
+		start = Board::makeStandardBoard();
+	} else if (kind == "fen") {
+		const size_t moves = std::min(args.find(" moves"), args.size());
+		string_view fen = args.substr(0, moves);
+		fen.remove_prefix(std::min(fen.find_first_not_of(' '), fen.size()));
+		start = Board::fromFen(fen);
+		args.remove_prefix(moves);
+	}
+	if (!start.has_value()) return;
+
+	board = *start;
+	history.reset(board);
+	if (nextToken(args) != "moves") return;
+	// the moves up to the first one that cannot be played
+	for (string_view s=nextToken(args); !s.empty(); s=nextToken(args)) {
+		const optional<Move> m = parseMove(board, s);
+		if (!m.has_value()) break;
+		history.push(board, board.makeMove(*m));
+	}
+}
+
+void Ucci::go(string_view args) {
+	halt();
+
+	SearchLimits limits;
+	std::int64_t time = 0, increment = 0, movesToGo = 0;
+	for (string_view key=nextToken(args); !key.empty(); key=nextToken(args)) {
+		if (key=="infinite" || key=="ponder" || key=="draw") continue;
+		const optional<std::int64_t> value = parseNumber<std::int64_t>(nextToken(args));
+		if (!value.has_value() || *value < 0) continue;
+		if (key == "depth") limits.depth = std::max<std::int64_t>(1, std::min<std::int64_t>(*value, Search::MAX_PLY));
+		else if (key == "nodes") limits.nodes = *value;
+		else if (key == "movetime") limits.movetimeMs = std::max<std::int64_t>(1, *value);
+		else if (key == "time") time = *value;
+		else if (key == "increment") increment = *value;
+		else if (key == "movestogo") movesToGo = *value;
+	}
+	// an even share of the clock, leaving a margin for the moves beyond movestogo
+	if (time > 0 && limits.movetimeMs == 0) {
+		limits.movetimeMs = std::max<std::int64_t>(1, std::min(time/2, time/(movesToGo>0 ?movesToGo :30) + increment/2));
+	}
+
+	if (const optional<Move> m = options.book ?options.book->bestMove(board) :nullopt) {
+		send("bestmove " + iccs(*m));
+		return;
+	}
+
+	// the copies are the searcher's; the I/O thread goes on reading meanwhile
+	stopPending.store(false);
+	searcher = std::thread([this, position=board, past=history, limits]{
+		const SearchResult r = search->run(position, past, limits, [this](const SearchResult &i) {
+			// a stop that came before run() started was cleared by it
+			if (stopPending.load()) search->stop();
+			std::ostringstream line;
+			line <<"info depth " <<i.depth <<" score " <<i.score <<" time " <<static_cast<long long>(i.seconds*1000)
+				<<" nodes " <<i.nodes <<" nps " <<static_cast<long long>(i.nodesPerSecond());
+			if (i.best != NO_MOVE) line <<" pv " <<iccs(i.best);
+			send(line.str());
+		});
+		send(r.best!=NO_MOVE ?"bestmove " + iccs(r.best) :string{"nobestmove"});
+	});
+}
+
+bool Ucci::command(string_view line) {
+	const string_view name = nextToken(line);
+	if (name == "ucci") {
+		send("id name cchess");
+		send("option hashsize type spin min 1 max 4096 default " + std::to_string(options.hashMegabytes));
+		send("option threads type spin min 1 max 64 default " + std::to_string(options.threads));
+		send("option newgame type button");
+		send("ucciok");
+	} else if (name == "isready") {
+		send("readyok");
+	} else if (name == "setoption") {
+		setOption(line);
+	} else if (name == "position") {
+		position(line);
+	} else if (name == "go") {
+		go(line);
+	} else if (name == "stop") {
+		stopPending.store(true);
+		search->stop();
+	} else if (name == "quit") {
+		halt();
+		send("bye");
+		return false;
+	}
+	return true;
+}
+
+void Ucci::serve(std::istream &in, std::ostream &out, const Options &options) {
+	Ucci engine{out, options};
+	for (string line; std::getline(in, line); ) {
+		if (!engine.command(line)) return;
+	}
+}
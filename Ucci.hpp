@@ -0,0 +1,72 @@
+#ifndef UCCI_HPP
+#define UCCI_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <thread>
+
+#include "Board.hpp"
+#include "History.hpp"
+#include "OpeningBook.hpp"
+#include "Search.hpp"
+#include "Tablebase.hpp"
+#include "TranspositionTable.hpp"
+
+// An engine speaking UCCI, the xiangqi dialect of UCI, one command per line:
+//   ucci, isready, setoption hashsize|threads <n>, setoption newgame,
+//   position {startpos | fen <fen>} [moves <iccs>...],
+//   go [depth <n>] [nodes <n>] [movetime <ms>] [time <ms> [increment <ms>] [movestogo <n>]] [infinite],
+//   stop, quit
+// Moves are in ICCS coordinates, see Notation::parseIccs(). A search runs on its own thread
+// and reports "info depth .. score .. time .. nodes .. nps .. pv .." per iteration, then
+// "bestmove"; input keeps being read meanwhile, and stop ends the search at its next node.
+class Ucci {
+	public:
+		struct Options {
+			int threads = 1;
+			std::size_t hashMegabytes = 64;
+			const Tablebases *tablebases = nullptr;
+			const OpeningBook *book = nullptr;
+		};
+
+	private:
+		std::ostream &out;
+		std::mutex outMutex;
+		Options options;
+		std::unique_ptr<TranspositionTable> tt;
+		std::unique_ptr<Search> search;
+		Board board{Board::makeStandardBoard()};
+		History history{board};
+		std::thread searcher;
+		// set by stop, or by a command that ends the search, until the next go
+		std::atomic<bool> stopPending{false};
+
+		void send(std::string_view line);
+		// stops the search of the last go, if any, and waits for its bestmove
+		void halt();
+		void makeSearch();
+		void position(std::string_view args);
+		void go(std::string_view args);
+		void setOption(std::string_view args);
+
+	public:
+		Ucci(std::ostream &out, const Options &options);
+		~Ucci();
+		Ucci(const Ucci &) = delete;
+		Ucci &operator =(const Ucci &) = delete;
+
+		// handles one line of input; false once it was quit
+		bool command(std::string_view line);
+		// blocks until the search of the last go, if any, has sent its bestmove
+		void wait();
+
+		// reads commands from `in` until quit or end of input, which stops a search as quit does
+		static void serve(std::istream &in, std::ostream &out, const Options &options);
+};
+
+#endif
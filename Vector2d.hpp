@@ -5,18 +5,18 @@
 
 struct Vector2d {
 	int x, y;
-	Vector2d(int x_, int y_): x(x_), y(y_) { }
-	Vector2d operator +(Vector2d other) const { return {x+other.x, y+other.y}; }
-	Vector2d operator -(Vector2d other) const { return {x-other.x, y-other.y}; }
-	Vector2d &operator +=(Vector2d other) { x += other.x; y += other.y; return *this; }
-	Vector2d &operator -=(Vector2d other) { x -= other.x; y -= other.y; return *this; }
-	bool operator ==(Vector2d other) const { return x==other.x && y==other.y; }
-	bool operator !=(Vector2d other) const { return x!=other.x || y!=other.y; }
-	bool isOnAxis() const { return x==0 || y==0; }
-	bool isZero() const { return x==0 && y==0; }
+	constexpr Vector2d(int x_, int y_): x(x_), y(y_) { }
+	constexpr Vector2d operator +(Vector2d other) const { return {x+other.x, y+other.y}; }
+	constexpr Vector2d operator -(Vector2d other) const { return {x-other.x, y-other.y}; }
+	constexpr Vector2d &operator +=(Vector2d other) { x += other.x; y += other.y; return *this; }
+	constexpr Vector2d &operator -=(Vector2d other) { x -= other.x; y -= other.y; return *this; }
+	constexpr bool operator ==(Vector2d other) const { return x==other.x && y==other.y; }
+	constexpr bool operator !=(Vector2d other) const { return x!=other.x || y!=other.y; }
+	constexpr bool isOnAxis() const { return x==0 || y==0; }
+	constexpr bool isZero() const { return x==0 && y==0; }
 
-	Vector2d quandrant() const;
-	static int quandrantInt(int k);
+	constexpr Vector2d quandrant() const { return {quandrantInt(x), quandrantInt(y)}; }
+	static constexpr int quandrantInt(int k) { return k<0 ?-1 :k>0 ?1 :0; }
 
 	friend std::ostream &operator <<(std::ostream &, Vector2d);
 };
@@ -0,0 +1,49 @@
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "Piece.hpp"
+#include "Square.hpp"
+#include "Team.hpp"
+
+// Fixed keys, so that a position hashes the same in every build and process;
+// opening books and other files written with one binary stay valid for the next.
+namespace Zobrist {
+	using SquareNS::N_SQUARE;
+
+	struct Keys {
+		std::array<std::array<std::uint64_t, N_SQUARE>, 2*PieceNS::N_KIND> piece;
+		std::uint64_t blackToMove;
+	};
+
+	constexpr std::uint64_t splitMix64(std::uint64_t &state) {
+		std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	constexpr Keys makeKeys() {
+		Keys keys{};
+		std::uint64_t state = 0x5851f42d4c957f2dull;
+		for (auto &row: keys.piece) {
+			for (std::uint64_t &k: row) k = splitMix64(state);
+		}
+		keys.blackToMove = splitMix64(state);
+		return keys;
+	}
+
+	inline constexpr Keys keys = makeKeys();
+
+	inline std::uint64_t pieceKey(PieceNS::Kind kind, Team team, int square) {
+		return keys.piece[static_cast<int>(team)*PieceNS::N_KIND + static_cast<int>(kind)][square];
+	}
+
+	inline std::uint64_t pieceKey(std::uint8_t id, int square) {
+		return pieceKey(PieceNS::kindOf(id), PieceNS::teamOf(id), square);
+	}
+}
+
+#endif
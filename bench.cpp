@@ -0,0 +1,1349 @@
+#include "Bench.hpp"
+#include "BinaryRecord.hpp"
+#include "Board.hpp"
+#include "BoardRenderer.hpp"
+#include "Evaluator.hpp"
+#include "History.hpp"
+#include "MappedFile.hpp"
+#include "MoveKernel.hpp"
+#include "Notation.hpp"
+#include "OpeningBook.hpp"
+#include "Search.hpp"
+#include "SelfPlay.hpp"
+#include "Tablebase.hpp"
+#include "TranspositionTable.hpp"
+#include "Ucci.hpp"
+#include "color.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <optional>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using std::cout;
+using std::endl;
+
+namespace {
+	// the start position and a middle game reached from it, with the side to move
+	struct BenchPosition {
+		Board board;
+		Team team;
+	};
+
+	// a deterministic game of `plies` moves picking the (ply*stride)th legal move each time
+	BenchPosition playedGame(const int plies, const int stride) {
+		Board board = Board::makeStandardBoard();
+		Team team = Team::red;
+		for (int ply=0; ply<plies; ++ply) {
+			const MoveList moves{board.generateMoves(team)};
+			board.makeMove(moves[ply*stride % moves.size()]);
+			team = otherTeam(team);
+		}
+		return {board, team};
+	}
+
+	BenchPosition middleGame() { return playedGame(24, 7); }
+
+	void benchMakeMove() {
+		const std::pair<const char *, BenchPosition> positions[]{
+			{"start", {Board::makeStandardBoard(), Team::red}}, {"middle game", middleGame()},
+		};
+		for (auto [where, pos]: positions) {
+			const MoveList moves{pos.board.generateMoves(pos.team)};
+
+			Bench::measure("makeMove+unmakeMove, " + std::string(where), moves.size(), [&]{
+				for (Move m: moves) {
+					const Undo undo{pos.board.makeMove(m)};
+					Bench::doNotOptimize(pos.board);
+					pos.board.unmakeMove(undo);
+				}
+			});
+
+			Bench::measure("copy+makeMove, " + std::string(where), moves.size(), [&]{
+				for (Move m: moves) {
+					Board next{pos.board};
+					next.makeMove(m);
+					Bench::doNotOptimize(next);
+				}
+			});
+		}
+	}
+
+	// time to reach a fixed depth on a fixed suite, for 1, 2, 4, ... threads up to every core
+	void benchSmp() {
+		constexpr int depth = 7;
+		const std::vector<BenchPosition> suite{
+			{Board::makeStandardBoard(), Team::red}, middleGame(), playedGame(16, 5), playedGame(40, 3),
+		};
+
+		const int cores = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<int> threadCounts;
+		for (int n=1; n<cores; n*=2) threadCounts.push_back(n);
+		threadCounts.push_back(cores);
+
+		TranspositionTable tt{64};
+		Search search{tt};
+		double baseline = 0;
+		for (int threads: threadCounts) {
+			search.setThreads(threads);
+			SearchLimits limits;
+			limits.depth = depth;
+
+			double seconds = 0;
+			std::uint64_t nodes = 0;
+			for (const BenchPosition &pos: suite) {
+				tt.clear();
+				const auto begin = std::chrono::steady_clock::now();
+				const SearchResult r{search.run(pos.board, limits)};
+				seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				nodes += r.nodes;
+			}
+
+			if (threads == 1) baseline = seconds;
+			cout <<"time to depth " <<depth <<", " <<threads <<" threads: " <<seconds <<" s, "
+				<<static_cast<std::uint64_t>(nodes / seconds) <<" nodes/s, speedup " <<baseline/seconds <<endl;
+		}
+	}
+
+	int scalarScore(const Board &board) {
+		int result = 0;
+		for (int i=0; i<Board::N_SQUARE; ++i) {
+			const Board::PieceId id = board.idAt(Board::vectorOf(i));
+			if (id != Board::NO_PIECE) result += Evaluator::squareScore(id, i);
+		}
+		return result;
+	}
+
+	// the incremental score must agree with both full recomputes on every position
+	void benchEval() {
+		int positions = 0, mismatches = 0;
+		for (int stride=1; stride<=20; ++stride) {
+			Board board = Board::makeStandardBoard();
+			for (int ply=0; ply<150; ++ply) {
+				const MoveList moves{board.generateMoves(board.sideToMove())};
+				if (moves.empty()) break;
+				board.makeMove(moves[ply*stride % moves.size()]);
+				++positions;
+				if (board.score()!=board.computeScore() || board.score()!=scalarScore(board)) ++mismatches;
+			}
+		}
+		cout <<"agreement: " <<positions <<" positions, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		const BenchPosition pos = middleGame();
+		Bench::measure("Evaluator::evaluate (incremental)", 1, [&]{ Bench::doNotOptimize(Evaluator::evaluate(pos.board)); });
+		Bench::measure("Board::computeScore (SIMD)", 1, [&]{ Bench::doNotOptimize(pos.board.computeScore()); });
+		Bench::measure("scalar recompute", 1, [&]{ Bench::doNotOptimize(scalarScore(pos.board)); });
+	}
+
+	// a game picking pseudo-random legal moves, at most `plies` long
+	std::vector<Move> randomGame(std::uint64_t &seed, const int plies) {
+		Board board = Board::makeStandardBoard();
+		std::vector<Move> game;
+		for (int ply=0; ply<plies; ++ply) {
+			const MoveList moves{board.generateMoves(board.sideToMove())};
+			if (moves.empty()) break;
+			seed = seed*6364136223846793005ull + 1442695040888963407ull;
+			game.push_back(moves[(seed >> 33) % moves.size()]);
+			board.makeMove(game.back());
+		}
+		return game;
+	}
+
+	// the regex path Command::quadFromStdin() used before Notation::parse()
+	std::optional<Move> parseWithRegex(const Board &board, const Team team, const std::string &s) {
+		static const std::regex e{R"((?:([jmpxswbz])[1-9]|[qh2-5][jmpxswbz1-9])[jtp][1-9])"};
+		std::smatch m;
+		if (!regex_match(s, m, e)) return std::nullopt;
+
+		const std::optional<Vector2d> from{m[1].matched
+			?board.parseSinglePiece(team, s[0], s[1])
+			:isdigit(s[1]) ?board.parseZuAtCol(team, s[0], s[1]) :board.parseMultiple(team, s[0], s[1])};
+		if (!from.has_value()) return std::nullopt;
+
+		const std::optional<Vector2d> to = board.parseDestByDirection(*from, s[2], s[3]);
+		if (!to.has_value()) return std::nullopt;
+		return Move{static_cast<std::uint8_t>(Board::indexOf(*from)), static_cast<std::uint8_t>(Board::indexOf(*to))};
+	}
+
+	// a million moves of random games in notation, parsed by both paths
+	void benchNotation() {
+		constexpr int plies = 200;
+		std::vector<std::vector<std::string>> corpus;
+		std::vector<std::vector<Move>> expected;
+		int total = 0;
+		for (std::uint64_t seed=1; total<1000000; ) {
+			expected.push_back(randomGame(seed, plies));
+			Board board = Board::makeStandardBoard();
+			corpus.emplace_back();
+			for (Move m: expected.back()) {
+				const std::array<char, 4> s{Notation::format(board, m)};
+				corpus.back().emplace_back(s.data(), s.size());
+				board.makeMove(m);
+			}
+			total += expected.back().size();
+		}
+
+		std::vector<std::vector<std::string_view>> views;
+		for (const std::vector<std::string> &game: corpus) views.emplace_back(game.begin(), game.end());
+		std::vector<Move> out(plies);
+
+		int mismatches = 0;
+		for (size_t g=0; g<corpus.size(); ++g) {
+			Board board = Board::makeStandardBoard();
+			Notation::ParseError error;
+			const int n = Notation::parseMoves(board, views[g].data(), views[g].size(), out.data(), error);
+			if (n!=(int)views[g].size() || !std::equal(out.begin(), out.begin()+n, expected[g].begin())) ++mismatches;
+
+			board = Board::makeStandardBoard();
+			for (size_t i=0; i<corpus[g].size(); ++i) {
+				if (parseWithRegex(board, board.sideToMove(), corpus[g][i]) != std::optional<Move>{expected[g][i]}) ++mismatches;
+				board.makeMove(expected[g][i]);
+			}
+		}
+		cout <<"corpus: " <<corpus.size() <<" games, " <<total <<" moves, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		Bench::measure("regex parse+makeMove", total, [&]{
+			for (const std::vector<std::string> &game: corpus) {
+				Board board = Board::makeStandardBoard();
+				for (const std::string &s: game) board.makeMove(*parseWithRegex(board, board.sideToMove(), s));
+			}
+		});
+
+		Bench::measure("Notation::parseMoves", total, [&]{
+			for (const std::vector<std::string_view> &game: views) {
+				Board board = Board::makeStandardBoard();
+				Notation::ParseError error;
+				Bench::doNotOptimize(Notation::parseMoves(board, game.data(), game.size(), out.data(), error));
+			}
+		});
+	}
+
+	bool samePosition(const Board &a, const Board &b) {
+		if (a.key()!=b.key() || a.score()!=b.score() || a.sideToMove()!=b.sideToMove()) return false;
+		for (int i=0; i<Board::N_SQUARE; ++i) {
+			if (a.idAt(Board::vectorOf(i)) != b.idAt(Board::vectorOf(i))) return false;
+		}
+		return true;
+	}
+
+	// writes `bytes` to a new temporary file and returns its path
+	std::optional<std::string> temporaryFile(const std::vector<std::uint8_t> &bytes) {
+		char path[] = "/tmp/cchess_benchXXXXXX";
+		const int fd = mkstemp(path);
+		if (fd < 0) return std::nullopt;
+		const bool written = write(fd, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size());
+		close(fd);
+		if (!written) {
+			unlink(path);
+			return std::nullopt;
+		}
+		return path;
+	}
+
+	// maps `bytes` through a temporary file, as the records would be read in use
+	std::optional<MappedFile> mapped(const std::vector<std::uint8_t> &bytes) {
+		const std::optional<std::string> path = temporaryFile(bytes);
+		if (!path.has_value()) return std::nullopt;
+		std::optional<MappedFile> file = MappedFile::open(path->c_str());
+		unlink(path->c_str());
+		return file;
+	}
+
+	// round trips of every position of random games, of randomly corrupted positions and
+	// of whole games, then the speed of bulk loading from a mapped file
+	void benchBinary() {
+		std::vector<Board> positions;
+		std::vector<std::vector<Move>> games;
+		for (std::uint64_t seed=1; positions.size()<200000; ) {
+			games.push_back(randomGame(seed, 200));
+			Board board = Board::makeStandardBoard();
+			positions.push_back(board);
+			for (Move m: games.back()) {
+				board.makeMove(m);
+				positions.push_back(board);
+			}
+		}
+
+		int mismatches = 0, corrupted = 0, accepted = 0;
+		std::uint64_t seed = 1;
+		for (const Board &board: positions) {
+			std::array<std::uint8_t, BinaryRecord::POSITION_SIZE> bytes, again;
+			board.pack(bytes.data());
+			const std::optional<Board> loaded = Board::unpack(bytes.data());
+			if (!loaded.has_value() || !samePosition(*loaded, board)) ++mismatches;
+
+			// a corrupted record must be rejected or load as a consistent position
+			seed = seed*6364136223846793005ull + 1442695040888963407ull;
+			bytes[(seed >> 33) % bytes.size()] = seed >> 56;
+			++corrupted;
+			if (const std::optional<Board> fuzzed = Board::unpack(bytes.data())) {
+				++accepted;
+				fuzzed->pack(again.data());
+				if (again!=bytes || fuzzed->key()!=fuzzed->computeKey() || fuzzed->score()!=fuzzed->computeScore()) ++mismatches;
+			}
+		}
+
+		std::vector<std::uint8_t> gameBytes;
+		for (const std::vector<Move> &game: games) {
+			const size_t offset = gameBytes.size();
+			gameBytes.resize(offset + BinaryRecord::gameSize(game.size()));
+			BinaryRecord::saveGame(Board::makeStandardBoard(), game.data(), game.size(), GameRecord::Result::draw, gameBytes.data() + offset);
+		}
+		BinaryRecord::GameReader reader{{reinterpret_cast<const char *>(gameBytes.data()), gameBytes.size()}};
+		size_t nGames = 0;
+		for (; const std::optional<BinaryRecord::Game> game = reader.next(); ++nGames) {
+			const std::vector<Move> &expected = games[nGames];
+			if (game->plies!=expected.size() || game->result!=GameRecord::Result::draw) {
+				++mismatches;
+				continue;
+			}
+			for (size_t i=0; i<game->plies; ++i) {
+				if (game->move(i) != expected[i]) ++mismatches;
+			}
+		}
+		if (nGames!=games.size() || reader.failed()) ++mismatches;
+
+		cout <<"round trip: " <<positions.size() <<" positions, " <<games.size() <<" games, " <<corrupted
+			<<" corrupted of which " <<accepted <<" still valid, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		std::vector<std::uint8_t> positionBytes(positions.size() * BinaryRecord::POSITION_SIZE);
+		Bench::measure("BinaryRecord::savePositions", positions.size(), [&]{
+			BinaryRecord::savePositions(positions.data(), positions.size(), positionBytes.data());
+			Bench::doNotOptimize(positionBytes[0]);
+		});
+
+		const std::optional<MappedFile> positionFile = mapped(positionBytes);
+		const std::optional<MappedFile> gameFile = mapped(gameBytes);
+		if (!positionFile.has_value() || !gameFile.has_value()) {
+			cout <<"cannot write a temporary file" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		std::vector<Board> loaded(positions.size(), Board::makeStandardBoard());
+		Bench::measure("BinaryRecord::loadPositions (mapped)", positions.size(), [&]{
+			Bench::doNotOptimize(BinaryRecord::loadPositions(positionFile->view(), loaded.data(), loaded.size()));
+		});
+
+		Bench::measure("BinaryRecord::GameReader (mapped)", games.size(), [&]{
+			BinaryRecord::GameReader r{gameFile->view()};
+			while (const std::optional<BinaryRecord::Game> game = r.next()) Bench::doNotOptimize(game->plies);
+		});
+		cout <<BinaryRecord::POSITION_SIZE <<" bytes per position, " <<gameBytes.size()/double(games.size())
+			<<" bytes per game" <<endl;
+	}
+
+	// FEN round trips of every position of random games and rejection of broken FENs, then
+	// the speed of parsing a file of FENs
+	void benchFen() {
+		std::vector<std::string> fens;
+		int mismatches = 0;
+		for (std::uint64_t seed=7; fens.size()<200000; ) {
+			Board board = Board::makeStandardBoard();
+			fens.push_back(board.fen());
+			for (Move m: randomGame(seed, 200)) {
+				board.makeMove(m);
+				fens.push_back(board.fen());
+				const std::optional<Board> loaded = Board::fromFen(fens.back());
+				// FEN gives pieces of a kind their slots in board order, so ids may differ
+				if (!loaded.has_value() || loaded->key()!=board.key() || loaded->score()!=board.score() || loaded->fen()!=fens.back()
+						|| loaded->halfmoveClock()!=board.halfmoveClock() || loaded->moveNumber()!=board.moveNumber()) ++mismatches;
+			}
+		}
+		if (fens[0] != "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1") ++mismatches;
+
+		const std::string_view invalid[]{
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABN w - - 0 1",     // short row
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNRR w - - 0 1",   // long row
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/RNBAKABNR w - - 0 1",      // nine rows
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR x - - 0 1",    // side to move
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 0",    // move number
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1 x",  // trailing field
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKQBNR w - - 0 1",    // unknown letter
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/2A6/RNB1KABNR w - - 0 1",  // Shi outside the palace
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/1B7/P1P1P1P1P/1C5C1/9/RN1AKABNR w - - 0 1",  // Xiang on a wrong square
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/2B6/9/P1P1P1P1P/1C5C1/9/RN1AKABNR w - - 0 1",  // Xiang across the river
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBA1ABNR w - - 0 1",    // no Jiang
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/2K6/RNBA1ABNR w - - 0 1",  // Jiang outside the palace
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/PPP1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",    // six Zu
+			"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/P8/RNBAKABNR w - - 0 1",   // Zu behind its start
+			"4k4/9/9/9/9/9/9/9/9/4K4 w - - 0 1",                                     // the Jiangs face each other
+			"4k4/9/9/9/9/9/9/9/4R4/3K5 w - - 0 1",                                   // black in check, red to move
+		};
+		for (const std::string_view fen: invalid) {
+			if (Board::fromFen(fen).has_value()) {
+				cout <<"accepted " <<fen <<endl;
+				++mismatches;
+			}
+		}
+		if (!Board::fromFen("4k4/9/9/9/9/9/9/9/4R4/3K5 b").has_value()) ++mismatches;
+
+		cout <<"round trip: " <<fens.size() <<" positions, " <<std::size(invalid) <<" invalid FENs, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		std::vector<std::uint8_t> bytes;
+		for (const std::string &fen: fens) {
+			bytes.insert(bytes.end(), fen.begin(), fen.end());
+			bytes.push_back('\n');
+		}
+		const std::optional<MappedFile> file = mapped(bytes);
+		if (!file.has_value()) {
+			cout <<"cannot write a temporary file" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		Bench::measure("Board::fromFen (mapped file)", fens.size(), [&]{
+			const std::string_view data = file->view();
+			for (size_t pos=0; pos<data.size(); ) {
+				const size_t eol = data.find('\n', pos);
+				Bench::doNotOptimize(Board::fromFen(data.substr(pos, eol-pos)));
+				pos = eol + 1;
+			}
+		});
+
+		const Board board = middleGame().board;
+		char buffer[Board::MAX_FEN_SIZE];
+		Bench::measure("Board::writeFen", 1, [&]{ Bench::doNotOptimize(board.writeFen(buffer)); });
+	}
+
+	// a book built from random games must hold exactly the counts of a std::map built from
+	// the same games; then the speed of lookups that hit and that miss
+	void benchBook() {
+		const OpeningBook::BuildOptions options;
+		std::map<std::pair<std::uint64_t, std::uint16_t>, std::uint32_t> expected;
+		std::vector<std::uint64_t> keys;
+		std::vector<std::uint8_t> archive;
+		std::uint64_t seed = 11;
+		for (int g=0; g<20000; ++g) {
+			Board board = Board::makeStandardBoard();
+			int ply = 0;
+			for (Move m: randomGame(seed, 60)) {
+				if (ply++ < options.maxPlies) {
+					++expected[{board.key(), static_cast<std::uint16_t>(m.from << 8 | m.to)}];
+					keys.push_back(board.key());
+				}
+				const std::array<char, 4> s{Notation::format(board, m)};
+				archive.insert(archive.end(), s.begin(), s.end());
+				archive.push_back(' ');
+				board.makeMove(m);
+			}
+			archive.insert(archive.end(), {'1', '/', '2', '-', '1', '/', '2', '\n', '\n'});
+		}
+
+		const std::optional<std::string> archivePath = temporaryFile(archive);
+		const std::optional<std::string> bookPath = temporaryFile({});
+		if (!archivePath.has_value() || !bookPath.has_value()) {
+			cout <<"cannot write a temporary file" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+		const std::optional<OpeningBook::BuildStats> stats = OpeningBook::build(archivePath->c_str(), bookPath->c_str(), options, std::cerr);
+		const std::optional<OpeningBook> book = OpeningBook::open(bookPath->c_str());
+		const std::optional<MappedFile> bookFile = MappedFile::open(bookPath->c_str());
+		unlink(archivePath->c_str());
+		unlink(bookPath->c_str());
+		if (!stats.has_value() || !book.has_value() || !bookFile.has_value()) {
+			cout <<"cannot build the book" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		// a book of `entries` with the header of the one built, as a corrupt file or a key
+		// collision could give
+		const auto bookOf = [&](const std::vector<OpeningBook::Entry> &entries) {
+			std::vector<std::uint8_t> bytes(bookFile->data(), bookFile->data() + 24);
+			const std::uint64_t count = entries.size();
+			std::memcpy(bytes.data() + 16, &count, sizeof count);
+			const std::uint8_t *e = reinterpret_cast<const std::uint8_t *>(entries.data());
+			bytes.insert(bytes.end(), e, e + entries.size()*sizeof(OpeningBook::Entry));
+			const std::optional<std::string> path = temporaryFile(bytes);
+			if (!path.has_value()) std::exit(EXIT_FAILURE);
+			std::optional<OpeningBook> result = OpeningBook::open(path->c_str());
+			unlink(path->c_str());
+			return result;
+		};
+		const Board start = Board::makeStandardBoard();
+		const auto entryOf = [&](const char *iccs, std::uint32_t games) {
+			return OpeningBook::Entry{start.key(), *Notation::parseIccs(iccs), 0, games, 0, 0, 0, 0};
+		};
+		// from an empty square and with a piece of the side not to move, both played more
+		const std::optional<OpeningBook> colliding = bookOf({entryOf("e5e4", 9), entryOf("h2e2", 1), entryOf("a9a8", 9)});
+		const bool collisionsSkipped = colliding.has_value() && colliding->bestMove(start) == Notation::parseIccs("h2e2");
+		// opening reads no entry, so one off the board is only skipped by bestMove()
+		std::vector<OpeningBook::Entry> offBoard{entryOf("h2e2", 1)};
+		offBoard[0].move.to = Board::N_SQUARE;
+		const std::optional<OpeningBook> corrupt = bookOf(offBoard);
+		if (!collisionsSkipped || !corrupt.has_value() || corrupt->bestMove(start).has_value()) {
+			cout <<"book: a colliding or off-board entry was taken" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		int mismatches = book->size()!=expected.size();
+		for (const auto &[keyMove, games]: expected) {
+			const Move m{static_cast<std::uint8_t>(keyMove.second >> 8), static_cast<std::uint8_t>(keyMove.second)};
+			bool found = false;
+			for (const OpeningBook::Entry &e: book->moves(keyMove.first)) {
+				if (e.move == m) found = e.games==games && e.draws==games;
+			}
+			if (!found) ++mismatches;
+		}
+		cout <<"book: " <<stats->games <<" games, " <<book->size() <<" entries in " <<stats->seconds <<" s, "
+			<<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		std::vector<std::uint64_t> misses(keys.size());
+		for (std::uint64_t &k: misses) k = seed = seed*6364136223846793005ull + 1442695040888963407ull;
+
+		Bench::measure("OpeningBook::moves (hit)", keys.size(), [&]{
+			for (std::uint64_t k: keys) Bench::doNotOptimize(book->moves(k).size());
+		});
+		Bench::measure("OpeningBook::moves (miss)", misses.size(), [&]{
+			for (std::uint64_t k: misses) Bench::doNotOptimize(book->moves(k).size());
+		});
+	}
+
+	// a random placement of `material` on allowed squares, often not a legal position
+	std::optional<Board> randomPosition(const Material &material, std::uint64_t &seed) {
+		std::array<std::uint8_t, Board::PACKED_SIZE> packed;
+		packed.fill(Board::NO_SQUARE);
+		for (int i=0; i<2*PieceNS::N_KIND; ++i) {
+			const PieceNS::Kind kind = static_cast<PieceNS::Kind>(i%PieceNS::N_KIND);
+			const Team team = static_cast<Team>(i/PieceNS::N_KIND);
+			const Bitboard allowed = Board::allowedSquares(kind, team);
+			for (int n=0; n<material.count(kind, team); ++n) {
+				seed = seed*6364136223846793005ull + 1442695040888963407ull;
+				Bitboard bits = allowed;
+				for (int skip=(seed >> 33) % BitboardNS::popCount(allowed); skip>0; --skip) BitboardNS::popLowest(bits);
+				packed[static_cast<int>(team)*PieceNS::N_SLOT_TEAM + PieceNS::firstSlotOfKind[static_cast<int>(kind)] + n] = BitboardNS::lowestSquare(bits);
+			}
+		}
+		seed = seed*6364136223846793005ull + 1442695040888963407ull;
+		if (seed >> 63) packed[0] |= 0x80;
+		return Board::unpack(packed.data());
+	}
+
+	// Generates tables on one thread and on every core, checks every sampled position
+	// against its children and short wins against the search, then times probes.
+	void benchTablebase() {
+		char directory[] = "/tmp/cchess_tbXXXXXX";
+		if (!mkdtemp(directory)) {
+			cout <<"cannot make a temporary directory" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		const Material material = *Material::parse("KNPvK");
+		const int cores = std::max(1u, std::thread::hardware_concurrency());
+		std::optional<Tablebase::GenerateStats> stats;
+		for (int threads=1; ; threads=cores) {
+			std::ostringstream log;
+			stats = Tablebase::generate(material, directory, threads, log);
+			if (!stats.has_value()) {
+				cout <<log.str() <<"cannot generate " <<material.name() <<endl;
+				std::exit(EXIT_FAILURE);
+			}
+			cout <<material.name() <<" and " <<stats->tables.size()-1 <<" smaller tables, " <<threads <<" threads: "
+				<<stats->seconds <<" s, " <<static_cast<std::uint64_t>(stats->positions / stats->seconds) <<" positions/s" <<endl;
+			if (threads == cores) break;
+		}
+
+		Tablebases tables;
+		tables.load(directory);
+		const std::optional<MappedFile> tableFile = MappedFile::open(stats->tables.back().c_str());
+		for (const std::string &path: stats->tables) unlink(path.c_str());
+		rmdir(directory);
+
+		// corrupt copies of the table: blocks out of order must not open, and runs that stop
+		// short of the end of their block must not be read past it
+		if (!tableFile.has_value()) std::exit(EXIT_FAILURE);
+		const std::vector<std::uint8_t> bytes(tableFile->data(), tableFile->data() + tableFile->size());
+		std::uint64_t positions;
+		std::memcpy(&positions, bytes.data() + 16, sizeof positions);
+		const std::size_t blocks = (positions + Tablebase::BLOCK_SIZE - 1) / Tablebase::BLOCK_SIZE;
+		const std::size_t offsetsStart = 48, dataStart = offsetsStart + (blocks+1)*sizeof(std::uint32_t);
+		const auto offsetOf = [&](const std::vector<std::uint8_t> &b, std::size_t block) {
+			std::uint32_t o;
+			std::memcpy(&o, b.data() + offsetsStart + block*sizeof o, sizeof o);
+			return o;
+		};
+		const auto openCopy = [](const std::vector<std::uint8_t> &b) {
+			const std::optional<std::string> path = temporaryFile(b);
+			if (!path.has_value()) std::exit(EXIT_FAILURE);
+			std::optional<Tablebase> t = Tablebase::open(path->c_str());
+			unlink(path->c_str());
+			return t;
+		};
+		std::vector<std::uint8_t> swapped{bytes};
+		std::memcpy(swapped.data() + offsetsStart + sizeof(std::uint32_t), swapped.data() + offsetsStart + blocks*sizeof(std::uint32_t), sizeof(std::uint32_t));
+		std::vector<std::uint8_t> shortRuns{bytes};
+		for (std::size_t b=0; b<blocks; ++b) {
+			const std::uint32_t begin = offsetOf(bytes, b), end = offsetOf(bytes, b+1);
+			if (end - begin == std::min<std::uint64_t>(Tablebase::BLOCK_SIZE, positions - b*Tablebase::BLOCK_SIZE)) continue;
+			for (std::uint32_t i=begin; i<end; i+=2) shortRuns[dataStart + i] = 0;
+		}
+		const std::optional<Tablebase> cut = openCopy(shortRuns);
+		if (openCopy(swapped).has_value() || !cut.has_value()) {
+			cout <<"corrupt table: blocks out of order were opened, or runs could not be" <<endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		TranspositionTable tt{16};
+		Search search{tt};
+		std::vector<Board> sample;
+		int mismatches = 0, searched = 0;
+		for (std::uint64_t seed=5; sample.size()<20000; ) {
+			const std::optional<Board> board = randomPosition(material, seed);
+			if (!board.has_value()) continue;
+			sample.push_back(*board);
+
+			const std::optional<Tablebase::Probe> p = tables.probe(*board);
+			if (!p.has_value()) {
+				++mismatches;
+				continue;
+			}
+
+			int wins = 0, draws = 0, losses = 0, shortestLoss = 1000, longestWin = -1;
+			const MoveList moves = board->generateMoves(board->sideToMove());
+			for (Move m: moves) {
+				Board child = *board;
+				child.makeMove(m);
+				const std::optional<Tablebase::Probe> c = tables.probe(child);
+				if (!c.has_value()) ++mismatches;
+				else if (c->wdl == Tablebase::Wdl::loss) ++losses, shortestLoss = std::min(shortestLoss, c->dtm);
+				else if (c->wdl == Tablebase::Wdl::win) ++wins, longestWin = std::max(longestWin, c->dtm);
+				else ++draws;
+			}
+			const bool consistent = p->wdl==Tablebase::Wdl::win ?losses>0 && shortestLoss==p->dtm-1
+				:p->wdl==Tablebase::Wdl::loss ?(moves.empty() ?p->dtm==0 :wins==(int)moves.size() && longestWin==p->dtm-1)
+				:losses==0 && draws>0;
+			if (!consistent) ++mismatches;
+
+			if (p->wdl==Tablebase::Wdl::win && p->dtm<=5 && searched<200) {
+				++searched;
+				SearchLimits limits;
+				// one more ply, as the search only notices a side without moves at full depth
+				limits.depth = p->dtm + 1;
+				tt.clear();
+				if (search.run(*board, limits).score != Search::MATE - p->dtm) ++mismatches;
+			}
+		}
+		int cutShort = 0;
+		for (const Board &b: sample) cutShort += !cut->probe(b).has_value();
+		cout <<"consistency: " <<sample.size() <<" positions and their children, " <<searched
+			<<" short wins searched, " <<mismatches <<" mismatches; " <<cutShort <<" not found with runs cut short" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		Bench::measure("Tablebases::probe", sample.size(), [&]{
+			for (const Board &b: sample) Bench::doNotOptimize(tables.probe(b));
+		});
+	}
+
+	// the pieces of `team` whose targetsOf() holds `index`, by asking every one of them
+	Bitboard scannedAttackers(const Board &board, const int index, const Team team) {
+		Bitboard result = 0;
+		for (Bitboard pieces=board.piecesOf(team); pieces; ) {
+			const int i = BitboardNS::popLowest(pieces);
+			if (BitboardNS::test(board.targetsOf(i), index)) result |= BitboardNS::bit(i);
+		}
+		return result;
+	}
+
+	// enemy pieces attacking the Jiang of `team`, the enemy Jiang included when facing it
+	Bitboard scannedCheckers(const Board &board, const Team team) {
+		const Bitboard jiang = board.piecesOf(PieceNS::Kind::jiang, team);
+		if (!jiang) return 0;
+		const Vector2d j = Board::vectorOf(BitboardNS::lowestSquare(jiang));
+		Bitboard result = 0;
+		for (Bitboard pieces=board.piecesOf(otherTeam(team)); pieces; ) {
+			const int i = BitboardNS::popLowest(pieces);
+			const Vector2d p = Board::vectorOf(i);
+			const bool facing = PieceNS::kindOf(board.idAt(p))==PieceNS::Kind::jiang && p.y==j.y && board.countPiecesBetween(p, j)==0;
+			if (facing || BitboardNS::test(board.targetsOf(i), Board::indexOf(j))) result |= BitboardNS::bit(i);
+		}
+		return result;
+	}
+
+	void benchAttacks() {
+		std::vector<Board> positions;
+		std::uint64_t seed = 11;
+		while (positions.size() < 20000) {
+			Board board = Board::makeStandardBoard();
+			for (Move m: randomGame(seed, 160)) {
+				board.makeMove(m);
+				positions.push_back(board);
+			}
+		}
+
+		std::uint64_t checks = 0, pins = 0, mismatches = 0;
+		for (const Board &board: positions) {
+			for (Team team: {Team::red, Team::black}) {
+				// on an empty square targetsOf() has a Pao slide rather than capture
+				for (Bitboard enemies=board.piecesOf(otherTeam(team)); enemies; ) {
+					const int i = BitboardNS::popLowest(enemies);
+					mismatches += board.attackersOf(i, team) != scannedAttackers(board, i, team);
+				}
+
+				const bool check = board.isInCheck(team);
+				checks += check;
+				mismatches += check != (scannedCheckers(board, team) != 0);
+			}
+
+			// Out of check, a piece of the side to move is pinned when taking it off puts its
+			// Jiang in check, which unpack() refuses once the other side is to move.
+			const Team us = board.sideToMove();
+			const Bitboard pinned = board.pinnedPieces(us);
+			std::uint8_t packed[Board::PACKED_SIZE];
+			board.pack(packed);
+			packed[0] ^= 0x80;
+			for (int slot=1; slot<PieceNS::N_SLOT_TEAM && !board.isInCheck(us); ++slot) {
+				const int k = static_cast<int>(us)*PieceNS::N_SLOT_TEAM + slot;
+				if (packed[k] == Board::NO_SQUARE) continue;
+				const std::uint8_t square = packed[k];
+				packed[k] = Board::NO_SQUARE;
+				const bool exposes = !Board::unpack(packed).has_value();
+				packed[k] = square;
+				pins += exposes;
+				mismatches += exposes != BitboardNS::test(pinned, square);
+			}
+
+			MoveList legal;
+			for (Move m: board.generatePseudoLegalMoves(us)) {
+				if (board.isLegal(m)) legal.push(m);
+			}
+			const MoveList generated{board.generateMoves(us)};
+			mismatches += generated.size()!=legal.size() || !std::equal(legal.begin(), legal.end(), generated.begin());
+		}
+		cout <<"agreement: " <<positions.size() <<" positions, " <<checks <<" checks, " <<pins <<" pinned pieces, "
+			<<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		const std::size_t n = positions.size();
+		Bench::measure("Board::isInCheck", n, [&]{
+			for (const Board &b: positions) Bench::doNotOptimize(b.isInCheck(b.sideToMove()));
+		});
+		Bench::measure("isInCheck by scanning attackers", n, [&]{
+			for (const Board &b: positions) Bench::doNotOptimize(scannedCheckers(b, b.sideToMove()));
+		});
+		Bench::measure("Board::attackersOf (Jiang square)", n, [&]{
+			for (const Board &b: positions) {
+				const int jiang = BitboardNS::lowestSquare(b.piecesOf(PieceNS::Kind::jiang, b.sideToMove()));
+				Bench::doNotOptimize(b.attackersOf(jiang, otherTeam(b.sideToMove())));
+			}
+		});
+		Bench::measure("Board::pinnedPieces", n, [&]{
+			for (const Board &b: positions) Bench::doNotOptimize(b.pinnedPieces(b.sideToMove()));
+		});
+		Bench::measure("Board::generateMoves", n, [&]{
+			for (const Board &b: positions) Bench::doNotOptimize(b.generateMoves(b.sideToMove()));
+		});
+	}
+
+	// PieceNS::Base::destOfDirection() as it was before MoveKernel, with its function-local
+	// tables of offsets
+	std::optional<Vector2d> referenceDest(const PieceNS::Kind kind, const Team team, const int direction, const Vector2d from, const char c) {
+		using PieceNS::Kind;
+		if (kind==Kind::ju || kind==Kind::pao || kind==Kind::jiang || kind==Kind::zu) {
+			if (direction == 0) {
+				const int y = Board::colToTeam(team, c - '1');
+				if (y == from.y) return std::nullopt;
+				return Vector2d{from.x, y};
+			}
+			const Vector2d p{from.x + direction*(c - '0'), from.y};
+			if (Board::inBound(p)) return p;
+			return std::nullopt;
+		}
+
+		static const std::vector<Vector2d> ma{{{2,1}, {1,2}, {-1,2}, {-2,1}, {-2,-1}, {-1,-2}, {1,-2}, {2,-1}}};
+		static const std::vector<Vector2d> shi{{{1,1}, {1,-1}, {-1,-1}, {-1,1}}};
+		static const std::vector<Vector2d> xiang{{{2,2}, {2,-2}, {-2,-2}, {-2,2}}};
+		if (direction == 0) return std::nullopt;
+		const int k = Board::colToTeam(team, c - '1');
+		for (Vector2d d: kind==Kind::ma ?ma :kind==Kind::shi ?shi :xiang) {
+			const Vector2d p = from + d;
+			if (!Board::inBound(p) || p.y != k) continue;
+			if ((p.x - from.x) * direction > 0) return p;
+		}
+		return std::nullopt;
+	}
+
+	void benchKernels() {
+		std::vector<Board> positions;
+		std::uint64_t seed = 5;
+		while (positions.size() < 2000) {
+			Board board = Board::makeStandardBoard();
+			for (Move m: randomGame(seed, 120)) {
+				board.makeMove(m);
+				positions.push_back(board);
+			}
+		}
+
+		// every (from, to) with a piece on from, and every notation suffix for it
+		struct Query { int from, to; };
+		std::vector<std::pair<const Board *, Query>> queries;
+		std::uint64_t pairs = 0, suffixes = 0, mismatches = 0;
+		for (const Board &board: positions) {
+			for (Bitboard pieces=board.occupancy(); pieces; ) {
+				const int from = BitboardNS::popLowest(pieces);
+				const Board::PieceId id = board.idAt(Board::vectorOf(from));
+				const PieceNS::Kind kind = PieceNS::kindOf(id);
+				const Team team = PieceNS::teamOf(id);
+				const Bitboard targets = board.targetsOf(from);
+				for (int to=0; to<Board::N_SQUARE; ++to) {
+					if (to == from) continue;
+					++pairs;
+					const bool own = BitboardNS::test(board.piecesOf(team), to);
+					const bool candidate = MoveKernel::isMoveCandidate(kind, team, board, from, to);
+					mismatches += candidate != PieceNS::pieceOf(id).isMoveCandidate(board, Board::vectorOf(from), Board::vectorOf(to));
+					mismatches += !own && candidate!=BitboardNS::test(targets, to);
+					if (queries.size() < 200000) queries.push_back({&board, {from, to}});
+				}
+				for (int direction: {-1, 0, 1}) {
+					for (char c='1'; c<='9'; ++c) {
+						++suffixes;
+						const int to = MoveKernel::destOfDirection(kind, team, direction, from, c);
+						const std::optional<Vector2d> expected = referenceDest(kind, team, direction, Board::vectorOf(from), c);
+						mismatches += expected.has_value() ?to!=Board::indexOf(*expected) :to!=Board::NO_SQUARE;
+					}
+				}
+			}
+		}
+		cout <<"agreement: " <<pairs <<" (from, to) pairs, " <<suffixes <<" notation suffixes, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		Bench::measure("isMoveCandidate, virtual", queries.size(), [&]{
+			for (const auto &[board, q]: queries) {
+				const Board::PieceId id = board->idAt(Board::vectorOf(q.from));
+				Bench::doNotOptimize(PieceNS::pieceOf(id).isMoveCandidate(*board, Board::vectorOf(q.from), Board::vectorOf(q.to)));
+			}
+		});
+		Bench::measure("isMoveCandidate, kernel switch", queries.size(), [&]{
+			for (const auto &[board, q]: queries) {
+				const Board::PieceId id = board->idAt(Board::vectorOf(q.from));
+				Bench::doNotOptimize(MoveKernel::isMoveCandidate(PieceNS::kindOf(id), PieceNS::teamOf(id), *board, q.from, q.to));
+			}
+		});
+
+		// a Ma of each team on every square, asked for every direction and column
+		std::vector<std::pair<Team, int>> mas;
+		for (Team team: {Team::red, Team::black}) {
+			for (int i=0; i<Board::N_SQUARE; ++i) mas.push_back({team, i});
+		}
+		const std::uint64_t n = mas.size() * 18;
+		Bench::measure("Ma destOfDirection, static vector", n, [&]{
+			for (const auto &[team, from]: mas) {
+				for (int direction: {-1, 1}) {
+					for (char c='1'; c<='9'; ++c) Bench::doNotOptimize(referenceDest(PieceNS::Kind::ma, team, direction, Board::vectorOf(from), c));
+				}
+			}
+		});
+		Bench::measure("Ma destOfDirection, virtual", n, [&]{
+			for (const auto &[team, from]: mas) {
+				const PieceNS::Base &ma = PieceNS::pieceOf(PieceNS::Kind::ma, team);
+				for (int direction: {-1, 1}) {
+					for (char c='1'; c<='9'; ++c) Bench::doNotOptimize(ma.destOfDirection(direction, Board::vectorOf(from), c));
+				}
+			}
+		});
+		Bench::measure("Ma destOfDirection, kernel", n, [&]{
+			for (const auto &[team, from]: mas) {
+				for (int direction: {-1, 1}) {
+					for (char c='1'; c<='9'; ++c) Bench::doNotOptimize(MoveKernel::destOfDirection(PieceNS::Kind::ma, team, direction, from, c));
+				}
+			}
+		});
+	}
+
+	// plays `moves` from `fen`, pushing every position
+	std::optional<std::pair<Board, History>> playedLine(const char *fen, std::initializer_list<Move> moves) {
+		std::optional<Board> board = Board::fromFen(fen);
+		if (!board.has_value()) return std::nullopt;
+		History history{*board};
+		for (Move m: moves) {
+			if (!board->isLegal(m)) return std::nullopt;
+			history.push(*board, board->makeMove(m));
+		}
+		return std::make_pair(*board, history);
+	}
+
+	void benchRepetition() {
+		using Perpetual = History::Perpetual;
+		struct Case {
+			const char *name, *fen;
+			std::initializer_list<Move> moves;
+			Perpetual red, black;
+			std::optional<Team> loser;
+		};
+		const Case cases[]{
+			// both Ju step out and back
+			{"idle", "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",
+				{{81, 72}, {0, 9}, {72, 81}, {9, 0}}, Perpetual::none, Perpetual::none, std::nullopt},
+			// the Ju checks along the back ranks, the Jiang steps up and down
+			{"check", "3k5/9/9/9/9/9/9/9/9/R3K4 w - - 0 1",
+				{{81, 0}, {3, 12}, {0, 9}, {12, 3}, {9, 0}}, Perpetual::check, Perpetual::none, Team::red},
+			// the Ju follows an undefended Ma
+			{"chase", "4k4/9/n8/9/9/1R7/9/9/9/3K5 w - - 0 1",
+				{{46, 45}, {18, 37}, {45, 46}, {37, 18}}, Perpetual::chase, Perpetual::none, Team::red},
+			// the same with the Ma defended on both squares by a Ju: no longer a chase
+			{"defended", "4k4/9/n7r/9/8r/1R7/9/9/9/3K5 w - - 0 1",
+				{{46, 45}, {18, 37}, {45, 46}, {37, 18}}, Perpetual::none, Perpetual::none, std::nullopt},
+			// a crossed Zu steps between an undefended Ma and Pao: a Zu may chase
+			{"zu", "4k4/9/9/3nc4/3P5/9/9/9/9/3K5 w - - 0 1",
+				{{39, 40}, {4, 13}, {40, 39}, {13, 4}}, Perpetual::none, Perpetual::none, std::nullopt},
+		};
+
+		int mismatches = 0;
+		for (const Case &c: cases) {
+			const auto line = playedLine(c.fen, c.moves);
+			if (!line.has_value() || line->second.lastRepeat() != 4 || line->second.repetitions() != 1) {
+				cout <<c.name <<": no repetition found" <<endl;
+				++mismatches;
+				continue;
+			}
+			const History::Cycle cycle = line->second.classify(line->first, 4);
+			if (cycle.of(Team::red)!=c.red || cycle.of(Team::black)!=c.black || cycle.loser()!=c.loser) {
+				cout <<c.name <<": misclassified" <<endl;
+				++mismatches;
+			}
+		}
+
+		// red may not repeat the check that loses it the game
+		TranspositionTable tt{16};
+		Search search{tt};
+		SearchLimits limits;
+		limits.depth = 4;
+		if (const auto line = playedLine("3k5/9/9/9/9/9/9/9/9/R3K4 w - - 0 1", {{81, 0}, {3, 12}, {0, 9}, {12, 3}})) {
+			const SearchResult r{search.run(line->first, line->second, limits)};
+			if (r.best == Move{9, 0}) ++mismatches;
+			cout <<"search avoids perpetual check: " <<(r.best != Move{9, 0} ?"yes" :"no") <<endl;
+		} else {
+			++mismatches;
+		}
+		cout <<"classification: " <<std::size(cases) <<" cycles, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		// A shuffle game longer than History keeps, then a search line as deep as allowed
+		// going back and forth through the current position: once the line is popped, the
+		// repetitions found are those of the game alone.
+		{
+			Board board = Board::makeStandardBoard();
+			History history{board};
+			std::uint64_t seed = 7;
+			while (history.size() <= History::CAPACITY + 40) {
+				// quiet moves that give no check, so that the game cannot run into a corner
+				MoveList quiet;
+				for (Move m: board.generateMoves(board.sideToMove())) {
+					if (board.pieceExist(Board::vectorOf(m.to))) continue;
+					const Undo undo{board.makeMove(m)};
+					if (!board.isInCheck(board.sideToMove())) quiet.push(m);
+					board.unmakeMove(undo);
+				}
+				if (quiet.empty()) break;
+				seed = seed*6364136223846793005ull + 1442695040888963407ull;
+				history.push(board, board.makeMove(quiet[(seed >> 33) % quiet.size()]));
+			}
+			const std::uint64_t gameKey = history.key();
+			const int lastRepeat = history.lastRepeat(), repetitions = history.repetitions();
+
+			// a quiet move of a piece other than a Zu, which may step back; NO_MOVE if none
+			const auto shuffle = [&board]{
+				for (Move m: board.generateMoves(board.sideToMove())) {
+					const PieceNS::Kind kind = PieceNS::kindOf(board.idAt(Board::vectorOf(m.from)));
+					if (!board.pieceExist(Board::vectorOf(m.to)) && kind!=PieceNS::Kind::zu) return m;
+				}
+				return NO_MOVE;
+			};
+			std::vector<Undo> line;
+			while (static_cast<int>(line.size()) + 4 <= Search::MAX_PLY - 1) {
+				const Move first = shuffle();
+				if (first == NO_MOVE) break;
+				line.push_back(board.makeMove(first));
+				history.push(board, line.back());
+				const Move second = shuffle();
+				if (second == NO_MOVE) break;
+				line.push_back(board.makeMove(second));
+				history.push(board, line.back());
+				for (const Move m: {first, second}) {
+					const Move back{m.to, m.from};
+					if (!board.isMoveable(Board::vectorOf(back.from), Board::vectorOf(back.to)) || !board.isLegal(back)) break;
+					line.push_back(board.makeMove(back));
+					history.push(board, line.back());
+				}
+				if (history.key() != gameKey) break;
+			}
+			const int linePlies = line.size();
+			for (; !line.empty(); line.pop_back()) {
+				board.unmakeMove(line.back());
+				history.pop();
+			}
+			cout <<"shuffle game of " <<history.size()-1 <<" plies, search line of " <<linePlies <<" plies" <<endl;
+			if (board.halfmoveClock()<=History::CAPACITY || linePlies<Search::MAX_PLY-4
+					|| history.lastRepeat()!=lastRepeat || history.repetitions()!=repetitions) {
+				cout <<"a popped search line reads as a repetition" <<endl;
+				std::exit(EXIT_FAILURE);
+			}
+		}
+
+		// the worst case for a search node: a long reversible stretch with nothing repeated
+		Board board = Board::makeStandardBoard();
+		History history{board};
+		std::uint64_t seed = 3;
+		while (history.size() < 200) {
+			MoveList quiet;
+			for (Move m: board.generateMoves(board.sideToMove())) {
+				if (!board.pieceExist(Board::vectorOf(m.to))) quiet.push(m);
+			}
+			if (quiet.empty()) break;
+			seed = seed*6364136223846793005ull + 1442695040888963407ull;
+			const Move m = quiet[(seed >> 33) % quiet.size()];
+			const Undo undo{board.makeMove(m)};
+			history.push(board, undo);
+			if (history.lastRepeat()) {
+				history.pop();
+				board.unmakeMove(undo);
+			}
+		}
+		cout <<"line of " <<history.size()-1 <<" plies, halfmove clock " <<board.halfmoveClock() <<endl;
+		Bench::measure("History::lastRepeat (no repetition)", 1, [&]{ Bench::doNotOptimize(history.lastRepeat()); });
+		const Undo undo{history.lastMove(), Board::NO_PIECE, 0, 0, 0};
+		Bench::measure("History::push+pop", 1, [&]{
+			history.pop();
+			history.push(board, undo);
+			Bench::doNotOptimize(history.key());
+		});
+	}
+
+	void benchUcci() {
+		int mismatches = 0;
+		std::uint64_t seed = 5;
+		Board board = Board::makeStandardBoard();
+		for (Move played: randomGame(seed, 60)) {
+			for (Move m: board.generateMoves(board.sideToMove())) {
+				const std::array<char, 4> s = Notation::formatIccs(m);
+				if (Notation::parseIccs({s.data(), s.size()}) != m) ++mismatches;
+			}
+			board.makeMove(played);
+		}
+		if (Notation::formatIccs({Board::indexOf({7, 7}), Board::indexOf({7, 4})}) != std::array<char, 4>{'h', '2', 'e', '2'}) ++mismatches;
+
+		Ucci::Options options;
+		options.hashMegabytes = 16;
+		std::ostringstream out;
+		Ucci engine{out, options};
+		engine.command("position startpos moves h2e2 h9g7 h0g2 xxxx i9h9");
+		engine.command("go depth 4");
+		engine.wait();
+		const std::string played = out.str();
+		if (played.find("info depth 4 ") == std::string::npos || played.find("\nbestmove ") == std::string::npos) ++mismatches;
+		cout <<"ICCS round trip and go depth: " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		// from stop to bestmove of an infinite search, which has been running for a while
+		using Clock = std::chrono::steady_clock;
+		std::vector<double> latencies;
+		for (int i=0; i<20; ++i) {
+			engine.command("position startpos");
+			engine.command("go infinite");
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			const auto begin = Clock::now();
+			engine.command("stop");
+			engine.wait();
+			latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+		}
+		std::sort(latencies.begin(), latencies.end());
+		cout <<"stop latency: median " <<latencies[latencies.size()/2] <<" us, max " <<latencies.back() <<" us over "
+			<<latencies.size() <<" searches" <<endl;
+	}
+
+	// games replayed from the file must be legal and end as recorded; the same seed must give
+	// the same file on one thread and on two. A budget of a few nodes stops every search before
+	// depth 1 is done, which must still give a legal move rather than end the game.
+	void benchSelfPlay() {
+		SelfPlay::Settings settings;
+		settings.games = 8;
+		settings.maxPlies = 120;
+		settings.seed = 11;
+
+		SearchLimits byDepth, byNodes;
+		byDepth.depth = 3;
+		byNodes.nodes = 5;
+
+		int mismatches = 0;
+		for (const SearchLimits &limits: {byDepth, byNodes}) {
+			settings.limits = limits;
+			cout <<(limits.nodes ?"nodes " + std::to_string(limits.nodes) :"depth " + std::to_string(limits.depth)) <<':' <<endl;
+
+			std::vector<std::string> contents;
+			for (int threads: {1, 2}) {
+				char path[] = "/tmp/cchess_selfplayXXXXXX";
+				const int fd = mkstemp(path);
+				if (fd < 0) std::exit(EXIT_FAILURE);
+				close(fd);
+				settings.threads = threads;
+				std::ostringstream log;
+				const std::optional<SelfPlay::Stats> stats = SelfPlay::play(settings, path, log);
+				std::optional<MappedFile> file = MappedFile::open(path);
+				unlink(path);
+				if (!stats.has_value() || !file.has_value()) std::exit(EXIT_FAILURE);
+				contents.emplace_back(file->data(), file->size());
+				cout <<threads <<" threads: " <<stats->games <<" games, " <<stats->plies <<" moves, "
+					<<static_cast<long long>(stats->gamesPerHour()) <<" games/hour, busy";
+				for (std::size_t t=0; t<stats->busySeconds.size(); ++t) cout <<' ' <<static_cast<int>(stats->utilization(t)*100) <<'%';
+				cout <<endl;
+			}
+
+			int wrong = contents[0] != contents[1];
+			std::size_t games = 0;
+			BinaryRecord::GameReader reader{contents[0]};
+			for (; const std::optional<BinaryRecord::Game> game = reader.next(); ++games) {
+				Board board{game->start};
+				History history{board};
+				bool legal = game->scores != nullptr;
+				for (std::size_t i=0; i<game->plies && legal; ++i) {
+					legal = board.isLegal(game->move(i)) && std::abs(game->score(i)) <= Search::INF;
+					if (legal) history.push(board, board.makeMove(game->move(i)));
+				}
+				// a side is only lost without a legal move or by the repetition rules
+				const bool mated = board.generateMoves(board.sideToMove()).empty();
+				const bool repeated = history.repetitions() >= 2;
+				const bool ended = mated || repeated || game->plies == static_cast<std::size_t>(settings.maxPlies);
+				const GameRecord::Result loss = board.sideToMove()==Team::red ?GameRecord::Result::blackWin :GameRecord::Result::redWin;
+				const bool scored = mated ?game->result == loss :repeated || game->result == GameRecord::Result::draw;
+				if (!legal || !ended || !scored) ++wrong;
+			}
+			if (reader.failed() || games != settings.games) ++wrong;
+			cout <<"replayed " <<games <<" games: " <<wrong <<" mismatches" <<endl;
+			mismatches += wrong;
+		}
+		if (mismatches) std::exit(EXIT_FAILURE);
+	}
+
+	// discards what is written to it, keeping a buffer so that writes stay cheap
+	class NullBuffer: public std::streambuf {
+		private:
+			char buffer[4096];
+
+		public:
+			NullBuffer() { setp(buffer, buffer + sizeof buffer); }
+			int overflow(int c) override {
+				setp(buffer, buffer + sizeof buffer);
+				return traits_type::not_eof(c);
+			}
+	};
+
+	// the Board basics on a fixed set of positions: construction, isMoveable() by kind of
+	// the moving piece over every destination, countPiecesBetween() over every pair, print()
+	void benchBoard() {
+		const std::vector<BenchPosition> positions{
+			{Board::makeStandardBoard(), Team::red}, middleGame(), playedGame(40, 3), playedGame(80, 11),
+		};
+
+		Bench::measure("makeStandardBoard", 1, []{ Bench::doNotOptimize(Board::makeStandardBoard()); });
+
+		const char *const kindNames[PieceNS::N_KIND]{"jiang", "shi", "xiang", "ma", "ju", "pao", "zu"};
+		for (int k=0; k<PieceNS::N_KIND; ++k) {
+			std::vector<std::pair<const Board *, Vector2d>> pieces;
+			for (const BenchPosition &pos: positions) {
+				for (Team team: {Team::red, Team::black}) {
+					for (Bitboard b=pos.board.piecesOf(static_cast<PieceNS::Kind>(k), team); b; ) {
+						pieces.emplace_back(&pos.board, Board::vectorOf(BitboardNS::popLowest(b)));
+					}
+				}
+			}
+			if (pieces.empty()) continue;
+
+			const std::string name = "isMoveable, " + std::string(kindNames[k]);
+			Bench::measure(name, pieces.size() * (Board::N_SQUARE-1), [&]{
+				for (const auto &[board, from]: pieces) {
+					for (int to=0; to<Board::N_SQUARE; ++to) {
+						if (to != Board::indexOf(from)) Bench::doNotOptimize(board->isMoveable(from, Board::vectorOf(to)));
+					}
+				}
+			});
+		}
+
+		Bench::measure("countPiecesBetween", positions.size() * Board::N_SQUARE * Board::N_SQUARE, [&]{
+			for (const BenchPosition &pos: positions) {
+				for (int from=0; from<Board::N_SQUARE; ++from) {
+					for (int to=0; to<Board::N_SQUARE; ++to) {
+						Bench::doNotOptimize(pos.board.countPiecesBetween(Board::vectorOf(from), Board::vectorOf(to)));
+					}
+				}
+			}
+		});
+
+		NullBuffer null;
+		Bench::measure("print", positions.size(), [&]{
+			std::streambuf *const terminal = cout.rdbuf(&null);
+			for (const BenchPosition &pos: positions) pos.board.print();
+			cout.rdbuf(terminal);
+		});
+	}
+
+	// Board::print() as it was: 21 u32strings with the names spliced in, each converted
+	// by wstring_convert and written with endl
+	void referencePrint(const Board &board) {
+		std::array<std::u32string, 2*Board::N_ROW+1> strs {
+			{   U"一  二  三  四  五  六  七  八  九",
+				U"┌───┬───┬───┬───┬───┬───┬───┬───┐    -0",
+				U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
+				U"├───┼───┼───┼───┼───┼───┼───┼───┤    -1",
+				U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
+				U"├───╬───┼───┼───┼───┼───┼───╬───┤    -2",
+				U"│   │   │   │   │   │   │   │   │     ",
+				U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -3",
+				U"│   │   │   │   │   │   │   │   │     ",
+				U"├───┴───┴───┴───┴───┴───┴───┴───┤    -4",
+				U"│      楚河            漢界     │     ",
+				U"├───┬───┬───┬───┬───┬───┬───┬───┤    -5",
+				U"│   │   │   │   │   │   │   │   │     ",
+				U"╠───┼───╬───┼───╬───┼───╬───┼───╣    -6",
+				U"│   │   │   │   │   │   │   │   │     ",
+				U"├───╬───┼───┼───┼───┼───┼───╬───┤    -7",
+				U"│   │   │   │ ╲ │ ╱ │   │   │   │     ",
+				U"├───┼───┼───┼───┼───┼───┼───┼───┤    -8",
+				U"│   │   │   │ ╱ │ ╲ │   │   │   │     ",
+				U"└───┴───┴───┴───┴───┴───┴───┴───┘    -9",
+				U"９  ８  ７  ６  ５  ４  ３  ２  １",
+			}};
+
+		for (int i=0; i<Board::N_ROW; ++i) {
+			for (int j=Board::N_COL-1; j>=0; --j) {
+				if (!board.pieceExist({i,j})) continue;
+				const Piece &p=*board.pieceAt({i,j});
+				const std::u32string coloredName = std::u32string(getTeamColor(p.team)) + std::u32string(p.getName()) + std::u32string(TerminalColor::restore);
+				strs[1+i*2].replace(j*4, 2, coloredName);
+			}
+		}
+
+		std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> cvt;
+		for (const std::u32string &s: strs) {
+			cout <<cvt.to_bytes(s) <<endl;
+		}
+	}
+
+	// what `print` writes to cout
+	template <typename F> std::string captured(F print) {
+		std::ostringstream out;
+		std::streambuf *const terminal = cout.rdbuf(out.rdbuf());
+		print();
+		cout.rdbuf(terminal);
+		return out.str();
+	}
+
+	// the renderer against the old print() on the positions of random games, then frames
+	// per second of each way to draw, into a stream that discards them
+	void benchRender() {
+		std::vector<Board> boards;
+		std::vector<Move> moves;
+		for (std::uint64_t seed=1; boards.size()<2000; ) {
+			Board board = Board::makeStandardBoard();
+			for (Move m: randomGame(seed, 200)) {
+				boards.push_back(board);
+				moves.push_back(m);
+				board.makeMove(m);
+			}
+		}
+
+		int mismatches = 0;
+		for (const Board &board: boards) {
+			if (captured([&]{ referencePrint(board); }) != captured([&]{ board.print(); })) ++mismatches;
+		}
+
+		// update() from each position to the next redraws the squares that changed, then
+		// moves the cursor below the board; nothing once it is up to date
+		BoardRenderer renderer;
+		for (size_t i=0; i+1<boards.size(); ++i) {
+			renderer.frame(boards[i]);
+			const std::string_view diff = renderer.update(boards[i+1]);
+			long changed = 0;
+			for (int s=0; s<Board::N_SQUARE; ++s) changed += boards[i].idAt(Board::vectorOf(s)) != boards[i+1].idAt(Board::vectorOf(s));
+			if (std::count(diff.begin(), diff.end(), 'H') != changed + (changed>0) || renderer.update(boards[i+1]).size() != 0) ++mismatches;
+		}
+		cout <<"frames: " <<boards.size() <<" positions, " <<mismatches <<" mismatches" <<endl;
+		if (mismatches) std::exit(EXIT_FAILURE);
+
+		NullBuffer null;
+		const double before = Bench::measure("old print", boards.size(), [&]{
+			std::streambuf *const terminal = cout.rdbuf(&null);
+			for (const Board &board: boards) referencePrint(board);
+			cout.rdbuf(terminal);
+		});
+		const double after = Bench::measure("print", boards.size(), [&]{
+			std::streambuf *const terminal = cout.rdbuf(&null);
+			for (const Board &board: boards) board.print();
+			cout.rdbuf(terminal);
+		});
+		Bench::measure("BoardRenderer::frame", boards.size(), [&]{
+			for (const Board &board: boards) Bench::doNotOptimize(renderer.frame(board).size());
+		});
+		// one move per frame, as a spectator sees it
+		Bench::measure("BoardRenderer::update", boards.size(), [&]{
+			for (const Board &board: boards) Bench::doNotOptimize(renderer.update(board).size());
+		});
+		cout <<"print: " <<static_cast<long long>(before) <<" -> " <<static_cast<long long>(after) <<" frames/s" <<endl;
+	}
+
+	struct Benchmark {
+		std::string_view name;
+		void (*run)();
+	};
+
+	const Benchmark benchmarks[]{
+		{"board", benchBoard},
+		{"render", benchRender},
+		{"makemove", benchMakeMove},
+		{"smp", benchSmp},
+		{"eval", benchEval},
+		{"notation", benchNotation},
+		{"binary", benchBinary},
+		{"fen", benchFen},
+		{"book", benchBook},
+		{"tablebase", benchTablebase},
+		{"repetition", benchRepetition},
+		{"attacks", benchAttacks},
+		{"kernels", benchKernels},
+		{"ucci", benchUcci},
+		{"selfplay", benchSelfPlay},
+	};
+}
+
+// cchess_bench [--format=json|csv] [<filter>]
+// Runs every benchmark, or only those whose name contains the filter. With --format the
+// results are written to stdout in that format at the end and everything else to stderr.
+int main(int argc, char **argv) {
+	std::string_view filter;
+	std::optional<Bench::Format> format;
+	for (int i=1; i<argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (arg == "--format=json") format = Bench::Format::json;
+		else if (arg == "--format=csv") format = Bench::Format::csv;
+		else filter = arg;
+	}
+
+	std::streambuf *const stdoutBuffer = cout.rdbuf();
+	if (format.has_value()) cout.rdbuf(std::cerr.rdbuf());
+
+	for (const Benchmark &b: benchmarks) {
+		if (b.name.find(filter) == std::string_view::npos) continue;
+		cout <<"== " <<b.name <<endl;
+		Bench::group = b.name;
+		b.run();
+	}
+
+	if (format.has_value()) {
+		cout.rdbuf(stdoutBuffer);
+		Bench::report(cout, *format);
+	}
+}
@@ -0,0 +1,188 @@
+#include "Board.hpp"
+#include "GameServer.hpp"
+#include "Notation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+
+// Plays games against a GameServer from many connections at once and checks every answer
+// against the same rules run locally. Each request is a legal move, or now and then four
+// random characters of the notation; games are restarted with "new" when they end or grow
+// long. At most `inflight` requests are outstanding, so that the round trip measured is that
+// of a request among `sessions` open connections rather than the time to drain a queue.
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct Client {
+		Board board{Board::makeStandardBoard()};
+		int fd = -1;
+		int plies = 0;       // in the current game
+		int requests = 0;    // answered so far
+		std::optional<Move> expected; // the move the request makes, if it is valid
+		bool restarting = false;
+		Clock::time_point sent;
+		string input;
+	};
+
+	uint64_t next(uint64_t &state) {
+		state = state*6364136223846793005ull + 1442695040888963407ull;
+		return state >> 33;
+	}
+
+	// the next request of `c`, with the answer it must get recorded in c
+	string requestOf(Client &c, uint64_t &seed) {
+		const MoveList moves = c.board.generateMoves(c.board.sideToMove());
+		if (moves.empty() || c.plies >= 150) {
+			c.restarting = true;
+			return "new";
+		}
+		c.restarting = false;
+
+		string s;
+		if (next(seed)%8 == 0) {
+			static constexpr string_view pieces{"jmxszpqh"}, directions{"jtp"};
+			s = {pieces[next(seed)%pieces.size()], static_cast<char>('1' + next(seed)%9),
+				directions[next(seed)%directions.size()], static_cast<char>('1' + next(seed)%9)};
+		} else {
+			const std::array<char, 4> f = Notation::format(c.board, moves[next(seed)%moves.size()]);
+			s.assign(f.begin(), f.end());
+		}
+		c.expected = Notation::parse(c.board, c.board.sideToMove(), s);
+		if (c.expected.has_value() && !c.board.isMoveable(Board::vectorOf(c.expected->from), Board::vectorOf(c.expected->to))) c.expected.reset();
+		return s;
+	}
+
+	double percentile(const std::vector<double> &sorted, double p) {
+		return sorted.empty() ?0 :sorted[std::min(sorted.size()-1, static_cast<size_t>(p*sorted.size()))];
+	}
+}
+
+// cchess_loadgen <port|socket path> [<sessions> [<requests per session> [<inflight>]]]
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr <<"usage: " <<argv[0] <<" <port|socket path> [<sessions> [<requests per session> [<inflight>]]]" <<endl;
+		return EXIT_FAILURE;
+	}
+	const char *address = argv[1];
+	const int sessions = argc>2 ?std::atoi(argv[2]) :10000;
+	const int requests = argc>3 ?std::atoi(argv[3]) :20;
+	const int inflight = argc>4 ?std::atoi(argv[4]) :64;
+	if (sessions<=0 || requests<=0 || inflight<=0) return EXIT_FAILURE;
+
+	const Clock::time_point connecting = Clock::now();
+	std::vector<Client> clients(sessions);
+	const int epoll = epoll_create1(0);
+	for (int i=0; i<sessions; ++i) {
+		clients[i].fd = GameServer::connect(address);
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		if (clients[i].fd<0 || epoll_ctl(epoll, EPOLL_CTL_ADD, clients[i].fd, &event)!=0) {
+			std::cerr <<"cannot connect session " <<i <<" to " <<address <<": " <<std::strerror(errno) <<endl;
+			return EXIT_FAILURE;
+		}
+	}
+	cout <<sessions <<" sessions connected in " <<std::chrono::duration<double>(Clock::now() - connecting).count() <<" s" <<endl;
+
+	uint64_t seed = 1;
+	std::deque<int> idle;
+	for (int i=0; i<sessions; ++i) idle.push_back(i);
+	std::vector<double> roundTrips;
+	roundTrips.reserve(static_cast<size_t>(sessions) * requests);
+	int outstanding = 0, finished = 0, mismatches = 0;
+	uint64_t rejected = 0;
+
+	const Clock::time_point start = Clock::now();
+	epoll_event events[256];
+	while (finished < sessions) {
+		for (; outstanding<inflight && !idle.empty(); ++outstanding) {
+			Client &c = clients[idle.front()];
+			idle.pop_front();
+			const string line = requestOf(c, seed) + '\n';
+			c.sent = Clock::now();
+			if (write(c.fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+				std::cerr <<"write failed" <<endl;
+				return EXIT_FAILURE;
+			}
+		}
+
+		const int n = epoll_wait(epoll, events, std::size(events), 1000);
+		if (n <= 0) {
+			std::cerr <<"no answer from " <<address <<endl;
+			return EXIT_FAILURE;
+		}
+		for (int e=0; e<n; ++e) {
+			const int i = events[e].data.u32;
+			Client &c = clients[i];
+			char buffer[256];
+			const ssize_t got = read(c.fd, buffer, sizeof buffer);
+			if (got <= 0) {
+				std::cerr <<"session " <<i <<" closed by the server" <<endl;
+				return EXIT_FAILURE;
+			}
+			c.input.append(buffer, got);
+
+			for (size_t eol; (eol = c.input.find('\n')) != string::npos; ) {
+				const string answer = c.input.substr(0, eol);
+				c.input.erase(0, eol + 1);
+				roundTrips.push_back(std::chrono::duration<double, std::micro>(Clock::now() - c.sent).count());
+				--outstanding;
+
+				if (c.restarting) {
+					mismatches += answer != "ok";
+					c.board = Board::makeStandardBoard();
+					c.plies = 0;
+				} else if (c.expected.has_value()) {
+					mismatches += answer != "ok";
+					c.board.makeMove(*c.expected);
+					++c.plies;
+				} else {
+					mismatches += answer.rfind("error ", 0) != 0;
+					++rejected;
+				}
+
+				if (++c.requests < requests) {
+					idle.push_back(i);
+				} else {
+					++finished;
+				}
+			}
+		}
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	// the server's own account, with every session still open
+	string stats;
+	if (write(clients[0].fd, "stats\n", 6) == 6) {
+		char buffer[512];
+		for (ssize_t got; stats.find('\n') == string::npos && (got = read(clients[0].fd, buffer, sizeof buffer)) > 0; ) stats.append(buffer, got);
+	}
+	for (const Client &c: clients) close(c.fd);
+
+	std::sort(roundTrips.begin(), roundTrips.end());
+	cout <<roundTrips.size() <<" requests, " <<rejected <<" rejected, " <<mismatches <<" mismatches in " <<seconds <<" s: "
+		<<static_cast<long long>(roundTrips.size()/seconds) <<" requests/s" <<endl;
+	cout <<"round trip with " <<inflight <<" in flight: p50 " <<percentile(roundTrips, 0.5) <<" us, p99 "
+		<<percentile(roundTrips, 0.99) <<" us, max " <<(roundTrips.empty() ?0 :roundTrips.back()) <<" us" <<endl;
+	cout <<"server: " <<stats;
+	return mismatches ?EXIT_FAILURE :EXIT_SUCCESS;
+}
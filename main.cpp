@@ -1,18 +1,32 @@
+#include "BinaryRecord.hpp"
 #include "Board.hpp"
+#include "GameRecord.hpp"
+#include "GameServer.hpp"
+#include "History.hpp"
+#include "Notation.hpp"
+#include "OpeningBook.hpp"
+#include "Search.hpp"
+#include "SelfPlay.hpp"
+#include "Tablebase.hpp"
+#include "TranspositionTable.hpp"
+#include "Ucci.hpp"
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
 #include <optional>
-#include <regex>
-#include <cctype>
 #include <cstdlib>
+#include <cstring>
+#include <string>
 
 using std::cin;
 using std::cout;
 using std::endl;
 using std::optional;
 using std::nullopt;
-using std::regex;
-using std::smatch;
+using std::size_t;
 using std::string;
 
 // enum PieceType                                 { JU,       MA,       XIANG,    SHI,      JIANG,    PAO,      ZU,       NUM_PIECE };
@@ -41,34 +55,285 @@ struct Command {
 			exit(0);
 		}
 
-		static const regex e{R"((?:([jmpxswbz])[1-9]|[qh2-5][jmpxswbz1-9])[jtp][1-9])"};
-		smatch m;
-		if (!regex_match(s, m, e)) return nullopt;
+		const optional<Move> m = Notation::parse(board, currentPlayer, s);
+		if (!m.has_value()) return nullopt;
 
-		optional<Vector2d> from{[&]{
-			if (m[1].matched) {
-				return board.parseSinglePiece(currentPlayer, s[0], s[1]);
+		return Command{Board::vectorOf(m->from), Board::vectorOf(m->to)};
+	}
+};
+
+// ends the game on the third occurrence of a position, by the rules on perpetual check and chase
+bool adjudicateRepetition(const Board &board, const History &history) {
+	if (history.repetitions() < 2) return false;
+
+	const History::Cycle cycle = history.classify(board, history.lastRepeat());
+	if (const optional<Team> loser = cycle.loser()) {
+		cout <<cnName(*loser) <<" loses by perpetual " <<(cycle.of(*loser)==History::Perpetual::check ?"check" :"chase") <<endl;
+	} else {
+		cout <<"draw by repetition" <<endl;
+	}
+	return true;
+}
+
+struct Options {
+	optional<Team> engineTeam;
+	SearchLimits limits;
+	int threads = 1;
+	const char *importPath = nullptr;
+	const char *validatePath = nullptr;
+	optional<Board> start;
+	const char *bookPath = nullptr;
+	const char *buildBookFrom = nullptr, *buildBookTo = nullptr;
+	const char *tablebasePath = nullptr;
+	optional<Material> generateMaterial;
+	bool ucci = false;
+	const char *serveAddress = nullptr;
+	std::size_t sessions = 10000;
+	const char *selfPlayPath = nullptr;
+	SelfPlay::Settings selfPlay;
+
+	// cchess [--engine red|black] [--movetime <ms>] [--threads <n>] [--fen <fen>] [--book <file>] [--tablebases <dir>]
+	//        | --ucci [--threads <n>] [--book <file>] [--tablebases <dir>]
+	//        | --serve <port|socket path> [--sessions <n>]
+	//        | --import <file> | --validate <file> [--threads <n>] | --build-book <archive> <book>
+	//        | --generate-tablebase <material> <dir> [--threads <n>]
+	//        | --self-play <games> <file> [--threads <n>] [--depth <n> | --nodes <n>] [--seed <n>]
+	//          [--random-plies <n>] [--max-plies <n>]
+	static optional<Options> parse(int argc, char **argv) {
+		Options o;
+		o.limits.movetimeMs = 1000;
+		for (int i=1; i<argc; ++i) {
+			if (!strcmp(argv[i], "--engine") && i+1<argc) {
+				++i;
+				if (!strcmp(argv[i], "red")) o.engineTeam = Team::red;
+				else if (!strcmp(argv[i], "black")) o.engineTeam = Team::black;
+				else return nullopt;
+			} else if (!strcmp(argv[i], "--movetime") && i+1<argc) {
+				o.limits.movetimeMs = std::atoll(argv[++i]);
+				if (o.limits.movetimeMs <= 0) return nullopt;
+			} else if (!strcmp(argv[i], "--threads") && i+1<argc) {
+				o.threads = std::atoi(argv[++i]);
+				if (o.threads <= 0) return nullopt;
+			} else if (!strcmp(argv[i], "--import") && i+1<argc) {
+				o.importPath = argv[++i];
+			} else if (!strcmp(argv[i], "--fen") && i+1<argc) {
+				o.start = Board::fromFen(argv[++i]);
+				if (!o.start.has_value()) return nullopt;
+			} else if (!strcmp(argv[i], "--book") && i+1<argc) {
+				o.bookPath = argv[++i];
+			} else if (!strcmp(argv[i], "--build-book") && i+2<argc) {
+				o.buildBookFrom = argv[++i];
+				o.buildBookTo = argv[++i];
+			} else if (!strcmp(argv[i], "--tablebases") && i+1<argc) {
+				o.tablebasePath = argv[++i];
+			} else if (!strcmp(argv[i], "--generate-tablebase") && i+2<argc) {
+				o.generateMaterial = Material::parse(argv[++i]);
+				if (!o.generateMaterial.has_value()) return nullopt;
+				o.tablebasePath = argv[++i];
+			} else if (!strcmp(argv[i], "--depth") && i+1<argc) {
+				o.limits.depth = std::atoi(argv[++i]);
+				if (o.limits.depth <= 0 || o.limits.depth >= Search::MAX_PLY) return nullopt;
+			} else if (!strcmp(argv[i], "--nodes") && i+1<argc) {
+				o.limits.nodes = std::atoll(argv[++i]);
+				if (o.limits.nodes <= 0) return nullopt;
+			} else if (!strcmp(argv[i], "--self-play") && i+2<argc) {
+				o.selfPlay.games = std::atoll(argv[++i]);
+				o.selfPlayPath = argv[++i];
+			} else if (!strcmp(argv[i], "--seed") && i+1<argc) {
+				o.selfPlay.seed = std::strtoull(argv[++i], nullptr, 10);
+			} else if (!strcmp(argv[i], "--random-plies") && i+1<argc) {
+				o.selfPlay.randomPlies = std::atoi(argv[++i]);
+				if (o.selfPlay.randomPlies < 0) return nullopt;
+			} else if (!strcmp(argv[i], "--max-plies") && i+1<argc) {
+				o.selfPlay.maxPlies = std::atoi(argv[++i]);
+				if (o.selfPlay.maxPlies <= 0 || o.selfPlay.maxPlies > static_cast<int>(BinaryRecord::MAX_PLIES)) return nullopt;
+			} else if (!strcmp(argv[i], "--serve") && i+1<argc) {
+				o.serveAddress = argv[++i];
+			} else if (!strcmp(argv[i], "--sessions") && i+1<argc) {
+				o.sessions = std::atoll(argv[++i]);
+				if (o.sessions <= 0) return nullopt;
+			} else if (!strcmp(argv[i], "--ucci")) {
+				o.ucci = true;
+			} else if (!strcmp(argv[i], "--validate") && i+1<argc) {
+				o.validatePath = argv[++i];
 			} else {
-				return isdigit(s[1]) ?board.parseZuAtCol(currentPlayer, s[0], s[1]) :board.parseMultiple(currentPlayer, s[0], s[1]);
+				return nullopt;
 			}
-		}()};
+		}
+		return o;
+	}
+};
 
-		if (!from.has_value()) return nullopt;
+int main(int argc, char **argv) {
+	const optional<Options> options = Options::parse(argc, argv);
+	if (!options.has_value()) {
+		std::cerr <<"usage: " <<argv[0] <<" [--engine red|black] [--movetime <ms>] [--threads <n>] [--fen <fen>] [--book <file>] [--tablebases <dir>]"
+			" | --ucci [--threads <n>] [--book <file>] [--tablebases <dir>]"
+			" | --serve <port|socket path> [--sessions <n>]"
+			" | --import <file> | --validate <file> [--threads <n>] | --build-book <archive> <book>"
+			" | --generate-tablebase <material> <dir> [--threads <n>]"
+			" | --self-play <games> <file> [--threads <n>] [--depth <n> | --nodes <n>] [--seed <n>] [--random-plies <n>] [--max-plies <n>]" <<endl;
+		return EXIT_FAILURE;
+	}
 
-		optional<Vector2d> to = board.parseDestByDirection(*from, s[2], s[3]);
-		if (!to.has_value()) return nullopt;
+	if (options->importPath) {
+		const optional<GameRecord::ImportStats> stats = GameRecord::importArchive(options->importPath, std::cerr);
+		if (!stats.has_value()) {
+			std::cerr <<"cannot read " <<options->importPath <<endl;
+			return EXIT_FAILURE;
+		}
 
-		return Command{*from, *to};
+		cout <<stats->games <<" games, " <<stats->malformed <<" malformed, " <<stats->moves <<" moves in "
+			<<stats->seconds <<" s: " <<static_cast<long long>(stats->gamesPerSecond()) <<" games/s, "
+			<<static_cast<long long>(stats->movesPerSecond()) <<" moves/s" <<endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (options->validatePath) {
+		const optional<GameRecord::ValidationReport> report = GameRecord::validateArchive(options->validatePath, options->threads);
+		if (!report.has_value()) {
+			std::cerr <<"cannot read " <<options->validatePath <<endl;
+			return EXIT_FAILURE;
+		}
+
+		// one line per game: number, byte offset, verdict, plies played and final key
+		size_t illegal = 0;
+		for (size_t i=0; i<report->games.size(); ++i) {
+			const GameRecord::Validation &v = report->games[i];
+			cout <<i+1 <<' ' <<v.offset <<' ';
+			if (v.ok()) {
+				cout <<"legal " <<v.plies;
+			} else {
+				cout <<"illegal " <<v.plies+1 <<' ' <<Notation::errorName(v.error);
+				++illegal;
+			}
+			cout <<' ' <<std::hex <<std::setw(16) <<std::setfill('0') <<v.key <<std::dec <<'\n';
+		}
+		std::cerr <<report->games.size() <<" games, " <<illegal <<" illegal, " <<report->moves <<" moves on "
+			<<report->threads <<" threads in " <<report->seconds <<" s: "
+			<<static_cast<long long>(report->gamesPerSecond()) <<" games/s, "
+			<<static_cast<long long>(report->movesPerSecond()) <<" moves/s" <<endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (options->buildBookFrom) {
+		const optional<OpeningBook::BuildStats> stats = OpeningBook::build(options->buildBookFrom, options->buildBookTo, {}, std::cerr);
+		if (!stats.has_value()) {
+			std::cerr <<"cannot build " <<options->buildBookTo <<" from " <<options->buildBookFrom <<endl;
+			return EXIT_FAILURE;
+		}
+
+		cout <<stats->games <<" games, " <<stats->malformed <<" malformed, " <<stats->positions <<" positions, "
+			<<stats->entries <<" book entries in " <<stats->seconds <<" s" <<endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (options->generateMaterial.has_value()) {
+		const optional<Tablebase::GenerateStats> stats = Tablebase::generate(*options->generateMaterial, options->tablebasePath, options->threads, std::cerr);
+		if (!stats.has_value()) return EXIT_FAILURE;
+
+		cout <<stats->tables.size() <<" tables, " <<stats->positions <<" positions: " <<stats->wins <<" won, " <<stats->losses
+			<<" lost, " <<stats->draws <<" drawn, " <<stats->undecided <<" undecided, longest mate " <<stats->longestMate <<" plies, in " <<stats->seconds <<" s on "
+			<<options->threads <<" threads" <<endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (options->serveAddress) {
+		optional<GameServer> server = GameServer::listen(options->serveAddress, options->sessions, std::cerr);
+		if (!server.has_value()) return EXIT_FAILURE;
+		std::cerr <<"serving up to " <<options->sessions <<" games on " <<options->serveAddress <<endl;
+		server->run(std::cerr);
+		return EXIT_SUCCESS;
+	}
+
+	if (options->selfPlayPath) {
+		SelfPlay::Settings settings{options->selfPlay};
+		settings.threads = options->threads;
+		// fixed work per move, so that a seed always gives the same games
+		settings.limits = options->limits;
+		settings.limits.movetimeMs = 0;
+		if (settings.limits.nodes == 0 && settings.limits.depth == SearchLimits{}.depth) settings.limits.nodes = 20000;
+
+		const optional<SelfPlay::Stats> stats = SelfPlay::play(settings, options->selfPlayPath, std::cerr);
+		if (!stats.has_value()) {
+			std::cerr <<"cannot write " <<options->selfPlayPath <<endl;
+			return EXIT_FAILURE;
+		}
+
+		cout <<stats->games <<" games, " <<stats->plies <<" moves, " <<stats->nodes <<" nodes: "
+			<<stats->count(GameRecord::Result::redWin) <<" won by red, " <<stats->count(GameRecord::Result::blackWin) <<" won by black, "
+			<<stats->count(GameRecord::Result::draw) <<" drawn (" <<stats->repetitions <<" by repetition, " <<stats->moveCaps
+			<<" at the move cap) in " <<stats->seconds <<" s: " <<static_cast<long long>(stats->gamesPerHour()) <<" games/hour" <<endl;
+		for (size_t t=0; t<stats->busySeconds.size(); ++t) {
+			cout <<"thread " <<t <<": " <<stats->gamesPerThread[t] <<" games, " <<static_cast<int>(stats->utilization(t)*100) <<"% busy" <<endl;
+		}
+		return EXIT_SUCCESS;
 	}
-};
 
-int main() {
-	Board board = Board::makeStandardBoard();
-	Team currentPlayer = Team::red;
+	Tablebases tablebases;
+	if (options->tablebasePath && tablebases.load(options->tablebasePath) == 0) {
+		std::cerr <<"no tablebases in " <<options->tablebasePath <<endl;
+		return EXIT_FAILURE;
+	}
+
+	optional<OpeningBook> book;
+	if (options->bookPath) {
+		book = OpeningBook::open(options->bookPath);
+		if (!book.has_value()) {
+			std::cerr <<"cannot read book " <<options->bookPath <<endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (options->ucci) {
+		Ucci::Options o;
+		o.threads = options->threads;
+		o.tablebases = tablebases.size()>0 ?&tablebases :nullptr;
+		o.book = book.has_value() ?&*book :nullptr;
+		Ucci::serve(cin, cout, o);
+		return EXIT_SUCCESS;
+	}
+
+	Board board = options->start.value_or(Board::makeStandardBoard());
+	Team currentPlayer = board.sideToMove();
+	History history{board};
+	TranspositionTable tt{64};
+	Search search{tt};
+	search.setThreads(options->threads);
+	if (tablebases.size() > 0) search.setTablebases(&tablebases);
 
 	board.print();
 
 	while (true) {
+		// in xiangqi a side without a legal move has lost, in check or not
+		if (board.generateMoves(currentPlayer).empty()) {
+			cout <<cnName(currentPlayer) <<" has no legal move and loses" <<endl;
+			return 0;
+		}
+
+		if (options->engineTeam == currentPlayer) {
+			if (const optional<Move> m = book.has_value() ?book->bestMove(board) :nullopt) {
+				cout <<cnName(currentPlayer) <<": " <<Board::vectorOf(m->from) <<" -> " <<Board::vectorOf(m->to) <<"  book" <<endl;
+				history.push(board, board.makeMove(*m));
+				board.print();
+				if (adjudicateRepetition(board, history)) return 0;
+				currentPlayer = otherTeam(currentPlayer);
+				continue;
+			}
+
+			const SearchResult r = search.run(board, history, options->limits);
+			assert(r.best != NO_MOVE);
+
+			cout <<cnName(currentPlayer) <<": " <<Board::vectorOf(r.best.from) <<" -> " <<Board::vectorOf(r.best.to)
+				<<"  depth " <<r.depth <<", score " <<r.score <<", " <<r.nodes <<" nodes, "
+				<<static_cast<long long>(r.nodesPerSecond()) <<" nodes/s, tt hit rate " <<r.ttHitRate() <<endl;
+			history.push(board, board.makeMove(r.best));
+			board.print();
+			if (adjudicateRepetition(board, history)) return 0;
+			currentPlayer = otherTeam(currentPlayer);
+			continue;
+		}
+
 		cout <<cnName(currentPlayer) <<"> ";
 		optional<Command> c = Command::quadFromStdin(board, currentPlayer);
 		if (!c.has_value()) {
@@ -106,8 +371,14 @@ int main() {
 			continue;
 		}
 
-		board.makeMove(c->from, c->to);
+		if (!board.isLegal(Move{static_cast<std::uint8_t>(Board::indexOf(c->from)), static_cast<std::uint8_t>(Board::indexOf(c->to))})) {
+			cout <<"Moving the piece at " <<c->from <<" to " <<c->to <<" leaves the Jiang in check" <<endl;
+			continue;
+		}
+
+		history.push(board, board.makeMove(c->from, c->to));
 		board.print();
+		if (adjudicateRepetition(board, history)) return 0;
 		currentPlayer = otherTeam(currentPlayer);
 	}
 }